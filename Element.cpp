@@ -1,11 +1,24 @@
 #include "Element.h"
 
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <limits>
 #include <string>
 #include <SDL3/SDL.h>
 #include <SDL3_image/SDL_image.h>
 #include <algorithm> // for std::clamp
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define ELEMENT_X86 1
+    #include <immintrin.h>
+    #if defined(__GNUC__) || defined(__clang__)
+        #define ELEMENT_AVX2 __attribute__((target("avx2")))
+    #else
+        #define ELEMENT_AVX2
+    #endif
+#endif
 
 using namespace std;
 
@@ -14,16 +27,475 @@ using namespace bagel;
 
 
 namespace element {
-    // helper to find the first entity matching a mask
-    static ent_type findEntity(const Mask &mask) {
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (World::mask(e).test(mask))
-                return e;
+    constexpr float BULLET_SPEED = 600.f; // px/sec
+    constexpr float CREEP_SPEED = 100.f;  // px/sec, FAST waves move 1.6× as fast
+
+    // spawn parameters of wave `i` (0-based) from the wave table
+    static Wave waveAt(int i) {
+        const WaveStats &w = tables().waves[i];
+        return {w.count, (w.flags & WAVE_BOSS) ? 0.f : 0.5f,
+                (w.flags & WAVE_FAST) ? CREEP_SPEED * 1.6f : CREEP_SPEED,
+                w.hp, w.gold, CREEP_TEX[i % CREEP_TEX_COUNT]};
+    }
+
+    // room for `count` more entities carrying Ts, taken before a batch of known size
+    template <class ...Ts>
+    static void reserveFor(int count) {
+        World::reserveEntities(count);
+        (World::reserve<Ts>(count), ...);
+    }
+
+    // size / high-water mark / capacity and bytes of every storage that holds any
+    static void printUsage(int waveIndex) {
+        cout << "wave " << waveIndex + 1 << " cleared, storage size / peak / capacity (bytes):" << endl;
+        for (const ComponentInfo &c: Components) {
+            const Usage u = c.usage();
+            if (u.bytes > 0)
+                cout << "  " << u.name << ' ' << u.size << " / " << u.peak << " / " << u.capacity
+                     << " (" << u.bytes << ')' << endl;
         }
-        return ent_type{-1};
     }
 
-    constexpr float BULLET_SPEED = 600.f; // px/sec
+    // structural changes recorded by systems, applied at the flush sync point; one
+    // buffer per recording system so they don't serialize each other under the scheduler
+    struct HomingCommands : CommandBuffer {};
+    struct BulletHitCommands : CommandBuffer {};
+    static HomingCommands homingCommands;
+    static BulletHitCommands bulletHitCommands;
+
+    // bullets fired during the tick, spawned with a single createEntities at the flush
+    struct Volley
+    {
+        struct Shot {Transform t; Drawable d; Velocity v; TravelTime time; Damage damage; Target target;};
+        std::vector<Shot> shots;
+
+        void flush() {
+            World::createEntities<Transform, Drawable, Velocity, TravelTime, Damage, Target, Bullet_Tag>(
+                static_cast<size_type>(shots.size()),
+                [&](index_type i, Transform &t, Drawable &d, Velocity &v, TravelTime &time,
+                    Damage &damage, Target &target, Bullet_Tag &) {
+                    const Shot &s = shots[i];
+                    t = s.t;
+                    d = s.d;
+                    v = s.v;
+                    time = s.time;
+                    damage = s.damage;
+                    target = s.target;
+                });
+            shots.clear();
+        }
+    };
+    static Volley volley;
+
+    // road and tower occupancy per map tile
+    static TileGrid mapTiles;
+
+    // candidates per parallel_for job: cheap per-entity systems, and towers (grid queries)
+    constexpr int ENTITY_GRAIN = 2048;
+    constexpr int TOWER_GRAIN = 64;
+
+    // creeps bucketed by position (data: path progress), 2×2 map tiles per cell
+    using CreepGrid = SpatialGridOf<ent_type, float>;
+    static CreepGrid creepGrid(
+        {Element::MAP_TEX_PAD_X, Element::MAP_TEX_PAD_Y,
+         sprite_map.w * Element::TEX_SCALE, sprite_map.h * Element::TEX_SCALE},
+        Element::MAP_COLS / 2, Element::MAP_ROWS / 2);
+    // cell order and target choice: furthest along the path first
+    static bool furtherAlong(const CreepGrid::Entry &a, const CreepGrid::Entry &b) { return a.data > b.data; }
+
+    // -----------------------------------------------------------------------------
+    // Batch kernels over SoA lanes (scalar / SSE2 / AVX2, picked once at runtime).
+    // Every variant evaluates the same expressions in the same order, so results
+    // are bit-identical whichever one the CPU gets.
+    // Only movement integrates this way: path stepping is table lookups per creep and
+    // homing a random Transform lookup per bullet, and gathering either into lanes
+    // measured slower than the scalar loops.
+    // -----------------------------------------------------------------------------
+    namespace kernels {
+        static void integrateScalar(float *x, float *y, const float *vx, const float *vy,
+                                    int from, int n, float dt) {
+            for (int i = from; i < n; ++i) {
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+            }
+        }
+
+#ifdef ELEMENT_X86
+        static void integrateSSE2(float *x, float *y, const float *vx, const float *vy, int n, float dt) {
+            const __m128 d = _mm_set1_ps(dt);
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), d)));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(vy + i), d)));
+            }
+            integrateScalar(x, y, vx, vy, i, n, dt);
+        }
+
+        ELEMENT_AVX2 static void integrateAVX2(float *x, float *y, const float *vx, const float *vy,
+                                               int n, float dt) {
+            const __m256 d = _mm256_set1_ps(dt);
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i),
+                                                      _mm256_mul_ps(_mm256_loadu_ps(vx + i), d)));
+                _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i),
+                                                      _mm256_mul_ps(_mm256_loadu_ps(vy + i), d)));
+            }
+            integrateScalar(x, y, vx, vy, i, n, dt);
+        }
+#endif
+
+        struct Table {
+            void (*integrate)(float *x, float *y, const float *vx, const float *vy, int n, float dt);
+        };
+
+        static const Table &pick() {
+            static const Table table = [] {
+#ifdef ELEMENT_X86
+                if (SDL_HasAVX2()) return Table{integrateAVX2};
+                if (SDL_HasSSE2()) return Table{integrateSSE2};
+#endif
+                return Table{
+                    [](float *x, float *y, const float *vx, const float *vy, int n, float dt) {
+                        integrateScalar(x, y, vx, vy, 0, n, dt);
+                    }
+                };
+            }();
+            return table;
+        }
+
+        // scratch columns for one batch of entities gathered from their storages
+        struct Batch {
+            static constexpr int SIZE = 256;
+            alignas(32) float x[SIZE], y[SIZE], vx[SIZE], vy[SIZE];
+            int n = 0;
+        };
+    }
+
+    // -----------------------------------------------------------------------------
+    // Sprite batch: every quad that samples one texture goes into a single vertex /
+    // index buffer and is submitted with one SDL_RenderGeometry call per frame.
+    // -----------------------------------------------------------------------------
+    class SpriteBatch {
+    public:
+        void begin(SDL_Texture *texture) {
+            tex = texture;
+            float w = 1.f, h = 1.f;
+            SDL_GetTextureSize(texture, &w, &h);
+            invW = 1.f / w;
+            invH = 1.f / h;
+            verts.clear();
+            indices.clear();
+        }
+
+        // same placement as SDL_RenderTextureRotated: dst rotated clockwise about its centre
+        void add(const SDL_FRect &src, const SDL_FRect &dst, float angleDeg, SDL_FColor color = WHITE) {
+            const float hw = dst.w * 0.5f, hh = dst.h * 0.5f;
+            const float cx = dst.x + hw, cy = dst.y + hh;
+            float c = 1.f, s = 0.f;
+            if (angleDeg != 0.f) {
+                const float rad = angleDeg * (SDL_PI_F / 180.f);
+                c = SDL_cosf(rad);
+                s = SDL_sinf(rad);
+            }
+            // half-extent axes after rotation
+            const float ax = hw * c, ay = hw * s;
+            const float bx = -hh * s, by = hh * c;
+
+            const float u0 = src.x * invW, v0 = src.y * invH;
+            const float u1 = (src.x + src.w) * invW, v1 = (src.y + src.h) * invH;
+            const int base = static_cast<int>(verts.size());
+            verts.push_back({{cx - ax - bx, cy - ay - by}, color, {u0, v0}});
+            verts.push_back({{cx + ax - bx, cy + ay - by}, color, {u1, v0}});
+            verts.push_back({{cx + ax + bx, cy + ay + by}, color, {u1, v1}});
+            verts.push_back({{cx - ax + bx, cy - ay + by}, color, {u0, v1}});
+            for (int i: {0, 1, 2, 0, 2, 3})
+                indices.push_back(base + i);
+        }
+
+        void submit(SDL_Renderer *ren) const {
+            if (verts.empty()) return;
+            SDL_RenderGeometry(ren, tex, verts.data(), static_cast<int>(verts.size()),
+                               indices.data(), static_cast<int>(indices.size()));
+        }
+
+        static constexpr SDL_FColor WHITE = {1.f, 1.f, 1.f, 1.f};
+
+    private:
+        SDL_Texture *tex = nullptr;
+        float invW = 1.f, invH = 1.f;
+        std::vector<SDL_Vertex> verts;
+        std::vector<int> indices;
+    };
+
+    static SpriteBatch atlasSprites;
+    static SpriteBatch digitSprites;
+
+    // -----------------------------------------------------------------------------
+    // System profiler: time spent in every system each frame, kept over a rolling
+    // window for the overlay percentiles and optionally appended to a CSV.
+    // -----------------------------------------------------------------------------
+    class Profiler {
+    public:
+        enum System {Input, Ui, PlacingTower, Wave, PathNavigation, Endpoint, Targeting,
+                     Shooting, Homing, BulletHit, Flush, Movement, Draw, COUNT};
+        static constexpr const char *NAMES[COUNT] = {
+            "input", "ui", "placing_tower", "wave", "path_navigation", "endpoint", "targeting",
+            "shooting", "homing", "bullet_hit", "flush", "movement", "draw"};
+        static constexpr int WINDOW = 256; // frames
+
+        class Scope {
+        public:
+            Scope(Profiler &p, System s) : p(p), s(s), start(SDL_GetPerformanceCounter()) {}
+            ~Scope() { p.current[s] += SDL_GetPerformanceCounter() - start; }
+        private:
+            Profiler &p;
+            System s;
+            Uint64 start;
+        };
+
+        struct Stats {float p50, p99, max;}; // microseconds
+
+        void openCsv(const char *path) {
+            csv.open(path);
+            if (!csv) {
+                std::cerr << "cannot open profile csv " << path << std::endl;
+                return;
+            }
+            csv << "frame";
+            for (const char *name: NAMES) csv << ',' << name;
+            csv << ",total_us\n";
+        }
+
+        void endFrame() {
+            const double toUs = 1e6 / static_cast<double>(SDL_GetPerformanceFrequency());
+            double total = 0;
+            if (csv) csv << frame;
+            for (int i = 0; i < COUNT; ++i) {
+                const double us = static_cast<double>(current[i]) * toUs;
+                history[i][frame % WINDOW] = static_cast<float>(us);
+                total += us;
+                if (csv) csv << ',' << us;
+                current[i] = 0;
+            }
+            if (csv) csv << ',' << total << '\n';
+            ++frame;
+        }
+
+        Stats stats(System s) const {
+            const int n = std::min(frame, WINDOW);
+            if (n == 0) return {};
+            float sorted[WINDOW];
+            std::copy(history[s], history[s] + n, sorted);
+            std::sort(sorted, sorted + n);
+            return {sorted[n / 2], sorted[(n * 99) / 100], sorted[n - 1]};
+        }
+
+        bool overlay = false; // toggled with F3
+
+    private:
+        Uint64 current[COUNT]{};
+        float history[COUNT][WINDOW]{};
+        int frame = 0;
+        std::ofstream csv;
+    };
+
+    static Profiler profiler;
+
+    // Transforms as of the previous logic tick, by entity id, for render interpolation.
+    // Only what the simulation moves is kept: creeps on the path and flying bullets.
+    // Input-driven entities like the mouse ghost draw where they are now, not a tick late
+    class PreviousTransforms {
+    public:
+        void capture() {
+            for (auto &s: byId) s.e = ent_type{-1};
+            for (auto [e, t]: World::view<Transform>().with<PathProgress>()) keep(e, t);
+            for (auto [e, t]: World::view<Transform>().with<Velocity>()) keep(e, t);
+        }
+        const Transform *find(ent_type e) const {
+            if (static_cast<size_t>(e.id) >= byId.size()) return nullptr;
+            const Snapshot &s = byId[e.id];
+            return s.e.id == e.id && s.e.gen == e.gen ? &s.t : nullptr;
+        }
+
+    private:
+        struct Snapshot {ent_type e; Transform t;};
+
+        template <class T>
+        void keep(ent_type e, const T &t) {
+            if (static_cast<size_t>(e.id) >= byId.size())
+                byId.resize(e.id + 1, Snapshot{ent_type{-1}, {}});
+            byId[e.id] = {e, {t.p, t.a}};
+        }
+
+        std::vector<Snapshot> byId;
+    };
+
+    static PreviousTransforms previous;
+
+    // -----------------------------------------------------------------------------
+    // Replays: the MouseInput / UIIntent changes fed into every tick plus a hash of
+    // all Transform and HP storages after it, so playback stops at the first
+    // desynced tick.
+    //   header  "ELRP" u8 version, u8 ticks per second
+    //   tick    u8 changed (1 mouse, 2 intent) [i16 x, i16 y, u8 clicked] [u8 intent] u32 hash
+    // -----------------------------------------------------------------------------
+    namespace replay {
+        constexpr char MAGIC[4] = {'E', 'L', 'R', 'P'};
+        constexpr Uint8 VERSION = 1;
+        enum : Uint8 {MOUSE = 1, INTENT = 2};
+
+        // FNV-1a over every Transform and HP, folded to 32 bits
+        static Uint32 worldHash() {
+            Uint64 h = 14695981039346656037ull;
+            const auto mix = [&h](const void *data, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    h ^= static_cast<const Uint8 *>(data)[i];
+                    h *= 1099511628211ull;
+                }
+            };
+            for (auto [e, t]: World::view<Transform>()) {
+                const float v[3] = {t.p.x, t.p.y, t.a};
+                mix(&e.id, sizeof e.id);
+                mix(v, sizeof v);
+            }
+            for (auto [e, hp]: World::view<HP>()) {
+                const int v[3] = {e.id, hp.current, hp.initial};
+                mix(v, sizeof v);
+            }
+            return static_cast<Uint32>(h ^ h >> 32);
+        }
+
+        struct Tick {MouseInput mouse; UIAction intent; Uint32 hash;};
+
+        class Writer {
+        public:
+            bool open(const char *path, int tps) {
+                file = std::fopen(path, "wb");
+                if (file == nullptr) return false;
+                std::fwrite(MAGIC, 1, sizeof MAGIC, file);
+                put(VERSION);
+                put(static_cast<Uint8>(tps));
+                return true;
+            }
+            bool isOpen() const { return file != nullptr; }
+
+            // state going into the tick, only what changed since the last one
+            void input(const MouseInput &mouse, UIAction intent) {
+                Uint8 changed = 0;
+                if (first || mouse.x != last.mouse.x || mouse.y != last.mouse.y ||
+                    mouse.clicked != last.mouse.clicked)
+                    changed |= MOUSE;
+                if (first || intent != last.intent)
+                    changed |= INTENT;
+                put(changed);
+                if (changed & MOUSE) {
+                    put(static_cast<Sint16>(mouse.x));
+                    put(static_cast<Sint16>(mouse.y));
+                    put(static_cast<Uint8>(mouse.clicked));
+                }
+                if (changed & INTENT)
+                    put(static_cast<Uint8>(intent));
+                last.mouse = mouse;
+                last.intent = intent;
+                first = false;
+            }
+            // world state after the tick
+            void hash(Uint32 h) { put(h); }
+
+            ~Writer() {
+                if (file != nullptr) std::fclose(file);
+            }
+
+        private:
+            template <class T>
+            void put(T v) {
+                Uint8 bytes[sizeof(T)];
+                for (size_t i = 0; i < sizeof(T); ++i)
+                    bytes[i] = static_cast<Uint8>(static_cast<Uint32>(v) >> (8 * i)); // little endian
+                std::fwrite(bytes, 1, sizeof bytes, file);
+            }
+
+            std::FILE *file = nullptr;
+            Tick last{};
+            bool first = true;
+        };
+
+        class Reader {
+        public:
+            bool open(const char *path) {
+                file = std::fopen(path, "rb");
+                if (file == nullptr) return false;
+                char magic[4];
+                Uint8 version = 0;
+                return std::fread(magic, 1, sizeof magic, file) == sizeof magic &&
+                       std::equal(magic, magic + 4, MAGIC) && get(version) && version == VERSION &&
+                       get(tps);
+            }
+            int ticksPerSecond() const { return tps; }
+
+            // full state of the next tick, false at the end of the stream
+            bool next(Tick &t) {
+                Uint8 changed;
+                if (!get(changed)) return false;
+                if (changed & MOUSE) {
+                    Sint16 x, y;
+                    Uint8 clicked;
+                    if (!get(x) || !get(y) || !get(clicked)) return false;
+                    cur.mouse = {x, y, clicked != 0};
+                }
+                if (changed & INTENT) {
+                    Uint8 intent;
+                    if (!get(intent)) return false;
+                    cur.intent = static_cast<UIAction>(intent);
+                }
+                if (!get(cur.hash)) return false;
+                t = cur;
+                return true;
+            }
+
+            ~Reader() {
+                if (file != nullptr) std::fclose(file);
+            }
+
+        private:
+            template <class T>
+            bool get(T &v) {
+                Uint8 bytes[sizeof(T)];
+                if (std::fread(bytes, 1, sizeof bytes, file) != sizeof bytes) return false;
+                Uint32 u = 0;
+                for (size_t i = 0; i < sizeof(T); ++i)
+                    u |= static_cast<Uint32>(bytes[i]) << (8 * i);
+                v = static_cast<T>(u);
+                return true;
+            }
+
+            std::FILE *file = nullptr;
+            Uint8 tps = 0;
+            Tick cur{};
+        };
+    }
+
+    static replay::Writer recorder;
+
+    // logs the input a tick is about to consume (no-op unless --record)
+    static void recordInput() {
+        if (!recorder.isOpen()) return;
+        const ent_type mouse = World::singleton<Mouse_Tag>(), gs = World::singleton<GameState_Tag>();
+        if (mouse.id == -1 || gs.id == -1) return;
+        recorder.input(World::getComponent<MouseInput>(mouse), World::getComponent<UIIntent>(gs).action);
+    }
+    static void recordHash() {
+        if (recorder.isOpen()) recorder.hash(replay::worldHash());
+    }
+
+    // facing angle of the segment that ends at TURNS[i]
+    static const auto SEGMENT_ANGLE = [] {
+        std::array<float, TURN_COUNT> a{};
+        for (int i = 1; i < TURN_COUNT; ++i)
+            a[i] = SDL_atan2f(PATH.dir[i].y, PATH.dir[i].x) * (180.f / SDL_PI_F);
+        return a;
+    }();
 
     /// init helpers  // @formatter:off
     bool Element::prepareWindowAndTexture() {
@@ -214,6 +686,7 @@ namespace element {
         mouseEntity.addAll(
         Transform{{0,0}, 0.f},
         Drawable{{},{}},
+        Tint{SpriteBatch::WHITE},
         MouseInput{ 0, 0, false },
         Mouse_Tag{}
         );
@@ -241,37 +714,40 @@ namespace element {
             SpawnState{
                 -1, // waveIndex = 0
                 0, // remaining = number of creeps to spawn
-                0.f // timeLeft = spawn immediately
+                0.f, // timeLeft = spawn immediately
+                true // cleared = no wave to give memory back for yet
             }
         );
     }
-    void Element::createCreep(float speed, int hp, int goldBounty, SDL_FRect spriteRect) const {
-        Entity creepEntity = Entity::create();
-        creepEntity.addAll(
-            Transform{{TURNS[0].x, TURNS[0].y}, 0.f,},
-            Drawable{spriteRect, {spriteRect.w * TEX_SCALE, spriteRect.h * TEX_SCALE}},
-            WaypointIndex{1}, // head to waypoint #1
-            Velocity{{0.f, 0.f}},
-            Speed{speed},
-            HP{hp, hp},
-            Gold_Bounty{goldBounty},
-            Creep_Tag{}
-        );
+    void Element::createCreeps(int count, float speed, int hp, int goldBounty, SDL_FRect spriteRect) const {
+        World::createEntities<Transform, Drawable, WaypointIndex, PathProgress, Speed, HP, Gold_Bounty, Creep_Tag>(
+            count,
+            [&](index_type, Transform &t, Drawable &d, WaypointIndex &wi, PathProgress &pp, Speed &sp, HP &h,
+                Gold_Bounty &gb, Creep_Tag &) {
+                t = {{TURNS[0].x, TURNS[0].y}, 0.f};
+                d = {spriteRect, {spriteRect.w * TEX_SCALE, spriteRect.h * TEX_SCALE}};
+                wi = {1}; // head to waypoint #1
+                pp = {0.f};
+                sp = {speed};
+                h = {hp, hp};
+                gb = {goldBounty};
+            });
     }
-    void Element::createTower(float x, float y, float range, int healthDamage,
-                             float fire_rate, SDL_FRect spriteRect) const {
-        Entity creepEntity = Entity::create();
-        creepEntity.addAll(
+    ent_type Element::createTower(float x, float y, float range, int healthDamage,
+                                  float fire_rate, SDL_FRect spriteRect) const {
+        Entity towerEntity = Entity::create();
+        towerEntity.addAll(
             Transform{{x, y}, 0.f},
             Drawable{spriteRect, {spriteRect.w * TEX_SCALE, spriteRect.h * TEX_SCALE}},
             Range {range},
             Damage {healthDamage},
             FireRate {fire_rate, 0.0f},
-            Target {-1}
+            Target {ent_type{-1}}
         );
+        return towerEntity.entity();
     }
     void Element::createBullet(const SDL_FPoint &src, const SDL_FPoint &dst,
-                               int damage, int targetId) const {
+                               int damage, ent_type target) const {
         // compute direction & travel time
         float dx = dst.x - src.x;
         float dy = dst.y - src.y;
@@ -286,34 +762,26 @@ namespace element {
         float angDeg = SDL_atan2f(dy, dx) * RAD_TO_DEG;
         float travelTime = dist / BULLET_SPEED;
 
-        // now spawn the bullet entity
-        Entity b = Entity::create();
-        b.addAll(
+        // now queue the bullet entity, the volley spawns at the next sync point
+        volley.shots.push_back({
             Transform{src, angDeg},
             Drawable{BULLET_TEX, {BULLET_TEX.w * TEX_SCALE, BULLET_TEX.h * TEX_SCALE}},
             Velocity{vel},
             TravelTime{travelTime},
             Damage{damage},
-            Target{targetId},
-            Bullet_Tag{}
-        );
+            Target{target}
+        });
     }
     // @formatter:on
 
 
     /// systems
     void Element::input_system() const {
-        static const Mask mouseMask = MaskBuilder()
-                .set<Mouse_Tag>()
-                .set<MouseInput>()
-                .set<Transform>()
-                .build();
-
-        auto mouseEnt = findEntity(mouseMask);
+        auto mouseEnt = World::singleton<Mouse_Tag>();
         if (mouseEnt.id == -1) return;
 
         auto &mi = World::getComponent<MouseInput>(mouseEnt);
-        auto &t = World::getComponent<Transform>(mouseEnt);
+        auto t = World::getComponent<Transform>(mouseEnt); // SoA proxy, fields are references
 
         // 2) Clear last frame’s click
         mi.clicked = false;
@@ -322,6 +790,8 @@ namespace element {
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_EVENT_QUIT) exit(0);
+            if (e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_F3)
+                profiler.overlay = !profiler.overlay;
 
             if (e.type == SDL_EVENT_MOUSE_MOTION) {
                 mi.x = static_cast<int>(e.motion.x);
@@ -338,26 +808,36 @@ namespace element {
         }
     }
 
+    void Element::scripted_input_system(int frame) const {
+        auto mouseEnt = World::singleton<Mouse_Tag>();
+        if (mouseEnt.id == -1) return;
+
+        auto &mi = World::getComponent<MouseInput>(mouseEnt);
+        auto t = World::getComponent<Transform>(mouseEnt);
+        mi.clicked = false;
+
+        // the script is sorted by frame, replay every event due this step
+        const auto due = std::equal_range(
+            opts.script.begin(), opts.script.end(), InputEvent{frame, 0, 0, false},
+            [](const InputEvent &a, const InputEvent &b) { return a.frame < b.frame; });
+        for (auto it = due.first; it != due.second; ++it) {
+            mi.x = it->x;
+            mi.y = it->y;
+            mi.clicked = mi.clicked || it->clicked;
+            t.p.x = static_cast<float>(mi.x);
+            t.p.y = static_cast<float>(mi.y);
+        }
+    }
+
     void Element::ui_system() const {
         // 1) Read the one & only MouseInput entity
-        static const Mask mouseMask = MaskBuilder()
-                .set<Mouse_Tag>()
-                .set<MouseInput>()
-                .set<Transform>()
-                .build();
-
-        ent_type mouseEnt = findEntity(mouseMask);
+        ent_type mouseEnt = World::singleton<Mouse_Tag>();
         if (mouseEnt.id == -1) return;
         const auto &mi = World::getComponent<MouseInput>(mouseEnt);
         if (!mi.clicked) return; // only respond to an actual click
 
         // 2) Grab the single GameState (where UIIntent lives)
-        static const Mask intentMask = MaskBuilder()
-                .set<GameState_Tag>() // I assume this is your GameState tag
-                .set<UIIntent>()
-                .build();
-
-        ent_type gs = findEntity(intentMask);
+        ent_type gs = World::singleton<GameState_Tag>();
         if (gs.id == -1) return;
 
         auto &intent = World::getComponent<UIIntent>(gs);
@@ -365,18 +845,7 @@ namespace element {
             intent.action = UIAction::None; // reset before setting a new one
 
         // 3) Hit‐test every UIButton_Tag
-        static const Mask btnMask = MaskBuilder()
-                .set<UIButton_Tag>()
-                .set<Transform>()
-                .set<Drawable>()
-                .build();
-
-        for (ent_type b{0}; b.id <= World::maxId().id; ++b.id) {
-            if (!World::mask(b).test(btnMask))
-                continue;
-
-            const auto &t = World::getComponent<Transform>(b);
-            const auto &d = World::getComponent<Drawable>(b);
+        for (auto [b, t, d]: World::view<Transform, Drawable>().with<UIButton_Tag>()) {
             // @formatter:off
             float left   = t.p.x - d.size.x/2;
             float right  = t.p.x + d.size.x/2;
@@ -400,95 +869,67 @@ namespace element {
     }
 
     void Element::path_navigation_system() const {
-        static const Mask mask = MaskBuilder()
-                .set<Transform>()
-                .set<Speed>()
-                .set<WaypointIndex>()
-                .set<Velocity>()
-                .set<Creep_Tag>()
-                .build();
-
-        constexpr float SNAP = 1.0f; // px distance considered “arrived”
-
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (!World::mask(e).test(mask))
-                continue;
-
-            auto &t = World::getComponent<Transform>(e);
-            auto &wi = World::getComponent<WaypointIndex>(e);
-            const auto &sp = World::getComponent<Speed>(e);
-            auto &vel = World::getComponent<Velocity>(e);
-
+        const auto creeps = World::view<Transform, PathProgress, WaypointIndex, Speed>().with<Creep_Tag>();
+        parallel_for(creeps, ENTITY_GRAIN, [](ent_type, auto t, PathProgress &pp, WaypointIndex &wi, Speed &sp) {
             if (wi.idx >= TURN_COUNT)
-                continue; // creep already at the end
-
-            float wx = TURNS[wi.idx].x;
-            float wy = TURNS[wi.idx].y;
-
-            float dx = wx - t.p.x;
-            float dy = wy - t.p.y;
-            float distSq = dx * dx + dy * dy;
-
-            if (distSq < SNAP * SNAP) {
-                ++wi.idx; // snap & advance
-                if (wi.idx >= TURN_COUNT) // reached base – handled elsewhere
-                    continue;
-
-                dx = TURNS[wi.idx].x - t.p.x;
-                dy = TURNS[wi.idx].y - t.p.y;
-            }
-
-            float len = SDL_sqrtf(dx * dx + dy * dy);
-            if (len < 1e-4f) len = 1.0f;
-
-            vel.v = {
-                dx / len * sp.value, // pixels per second
-                dy / len * sp.value
-            };
-
-            t.a = RAD_TO_DEG * SDL_atan2f(vel.v.y, vel.v.x); // facing angle
-        }
+                return; // creep already at the end
+
+            // 1) advance along the path, stepping past every way-point we crossed
+            pp.s += sp.value * DT;
+            while (wi.idx < TURN_COUNT && pp.s >= PATH.s[wi.idx])
+                ++wi.idx;
+            if (wi.idx >= TURN_COUNT) // reached base – handled elsewhere
+                return;
+
+            // 2) position on the current segment + facing from the table
+            const TurnPt &from = TURNS[wi.idx - 1];
+            const SDL_FPoint &dir = PATH.dir[wi.idx];
+            const float along = pp.s - PATH.s[wi.idx - 1];
+            t.p = {from.x + dir.x * along, from.y + dir.y * along};
+            t.a = SEGMENT_ANGLE[wi.idx];
+        });
     }
 
     void Element::movement_system() const {
-        // Only entities with a Transform and a Velocity move
-        static const Mask mask = MaskBuilder()
-                .set<Transform>()
-                .set<Velocity>()
-                .build();
-
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (!World::mask(e).test(mask))
-                continue;
-
-            auto &t = World::getComponent<Transform>(e);
-            const auto &vel = World::getComponent<Velocity>(e);
+        const auto &k = kernels::pick();
+
+        // Only entities with a Transform and a Velocity move; one batch per job
+        const auto moving = World::view<Transform, Velocity>();
+        Jobs::run(moving.extent(), ENTITY_GRAIN, [&](index_type first, index_type last) {
+            kernels::Batch b;
+            SDL_FPoint *pos[kernels::Batch::SIZE];
+
+            const auto flush = [&] {
+                // DT is seconds per frame (1 / FPS)
+                k.integrate(b.x, b.y, b.vx, b.vy, b.n, DT);
+                for (int i = 0; i < b.n; ++i)
+                    *pos[i] = {b.x[i], b.y[i]};
+                b.n = 0;
+            };
 
-            // DT is seconds per frame (1 / FPS)
-            t.p.x += vel.v.x * DT;
-            t.p.y += vel.v.y * DT;
-        }
+            moving.each(first, last, [&](ent_type, auto t, Velocity &vel) {
+                const int i = b.n++;
+                pos[i] = &t.p;
+                b.x[i] = t.p.x;
+                b.y[i] = t.p.y;
+                b.vx[i] = vel.v.x;
+                b.vy[i] = vel.v.y;
+
+                if (b.n == kernels::Batch::SIZE)
+                    flush();
+            });
+            flush();
+        });
     }
 
     void Element::placing_tower_system() const {
-        static const Mask mouseMask = MaskBuilder()
-                .set<Mouse_Tag>()
-                .set<MouseInput>()
-                .set<Transform>()
-                .set<Drawable>()
-                .build();
-        static const Mask intentMask = MaskBuilder()
-                .set<GameState_Tag>()
-                .set<UIIntent>()
-                .build();
-
         // 1) Find mouse entity and UIIntent
-        ent_type mouseEnt = findEntity(mouseMask);
+        ent_type mouseEnt = World::singleton<Mouse_Tag>();
         if (mouseEnt.id == -1) return;
         auto &mi = World::getComponent<MouseInput>(mouseEnt);
         auto &mouseD = World::getComponent<Drawable>(mouseEnt);
 
-        ent_type gs = findEntity(intentMask);
+        ent_type gs = World::singleton<GameState_Tag>();
         if (gs.id == -1) return;
         auto &intent = World::getComponent<UIIntent>(gs);
 
@@ -500,73 +941,44 @@ namespace element {
 
         // 3) Pick the correct tower sprite for the ghost
         SDL_FRect spriteRect;
-        if (intent.action == UIAction::BuyArrow) spriteRect = TOWER_TEX_ARROW;
-        else if (intent.action == UIAction::BuyCannon) spriteRect = TOWER_TEX_CANNON;
-        else if (intent.action == UIAction::BuyAir) spriteRect = TOWER_TEX_AIR;
+        TowerKind kind;
+        if (intent.action == UIAction::BuyArrow) spriteRect = TOWER_TEX_ARROW, kind = TowerKind::Arrow;
+        else if (intent.action == UIAction::BuyCannon) spriteRect = TOWER_TEX_CANNON, kind = TowerKind::Cannon;
+        else if (intent.action == UIAction::BuyAir) spriteRect = TOWER_TEX_AIR, kind = TowerKind::Air;
         else return;
 
-        // 4) Attach ghost to mouse
+        // 4) Attach ghost to mouse, tinted red over road, towers or off the map
+        const SDL_Point cell = TileGrid::footprintAt({static_cast<float>(mi.x), static_cast<float>(mi.y)});
+        const bool free = mapTiles.canPlace(cell);
         mouseD.part = spriteRect;
         mouseD.size = {spriteRect.w * TEX_SCALE, spriteRect.h * TEX_SCALE};
-
-        // 5) On click, place real tower if inside map bounds
-        if (mi.clicked) {
-            float mx = mi.x, my = mi.y;
-            // map rectangle in screen coords:
-            float mapLeft = MAP_TEX_PAD_X;
-            float mapRight = MAP_TEX_PAD_X + MAP_TEX.w * TEX_SCALE;
-            float mapTop = MAP_TEX_PAD_Y;
-            float mapBottom = MAP_TEX_PAD_Y + MAP_TEX.h * TEX_SCALE;
-
-
-            if (mx >= mapLeft && mx <= mapRight && my >= mapTop && my <= mapBottom) {
-                if (intent.action == UIAction::BuyArrow) {
-                    createTower(mx, my, 200, 6, 0.5, spriteRect);
-                } else if (intent.action == UIAction::BuyCannon) {
-                    createTower(mx, my, 100, 10, 2, spriteRect);
-                } else if (intent.action == UIAction::BuyAir) {
-                    createTower(mx, my, 400, 3, 0.1, spriteRect);
-                }
-
-                intent.action = UIAction::None;
-                // clear ghost
-                mouseD.part = SDL_FRect{};
-            }
+        World::getComponent<Tint>(mouseEnt).color = free ? SpriteBatch::WHITE : SDL_FColor{1.f, .3f, .3f, .8f};
+
+        // 5) On click, place real tower on a free footprint, snapped to the tiles
+        if (mi.clicked && free) {
+            // first tier from the tower table, range scaled like the map
+            const TowerStats &stats = tables().tower(kind, 1);
+            const SDL_FPoint at = TileGrid::footprintCenter(cell);
+            mapTiles.place(cell, createTower(at.x, at.y, stats.range * TEX_SCALE,
+                                             stats.damage, stats.fireInterval, spriteRect));
+
+            intent.action = UIAction::None;
+            // clear ghost
+            mouseD.part = SDL_FRect{};
         }
     }
 
     void Element::endpoint_system() const {
-        // 1. Build masks
-        static const Mask creepMask = MaskBuilder()
-                .set<Creep_Tag>()
-                .set<WaypointIndex>()
-                .set<Transform>()
-                .set<HP>()
-                .set<Gold_Bounty>()
-                .build();
-
-        static const Mask playerMask = MaskBuilder()
-                .set<Player_Tag>()
-                .set<HP>()
-                .set<Gold>()
-                .build();
-
-        // 2. Find the player entity (cache once)
-        static ent_type player = findEntity(playerMask);
+        // 1. Find the player entity
+        ent_type player = World::singleton<Player_Tag>();
         if (player.id == -1) return; // no player found? bail
 
         auto &playerHP = World::getComponent<HP>(player);
         auto &playerGold = World::getComponent<Gold>(player);
 
-        // 3. Process each creep that’s reached the end
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (!World::mask(e).test(creepMask))
-                continue;
-
-            auto &wi = World::getComponent<WaypointIndex>(e);
-            auto &t = World::getComponent<Transform>(e);
-            const auto &bounty = World::getComponent<Gold_Bounty>(e);
-
+        // 2. Process each creep that’s reached the end
+        const auto creeps = World::view<WaypointIndex, PathProgress, Transform, Gold_Bounty>().with<HP, Creep_Tag>();
+        for (auto [e, wi, pp, t, bounty]: creeps) {
             if (wi.idx >= TURN_COUNT) {
                 // a) Penalize the player
                 playerHP.current = std::max(0, playerHP.current - 1);
@@ -575,6 +987,7 @@ namespace element {
                 // b) Respawn the creep at the start
                 t.p.x = TURNS[0].x;
                 t.p.y = TURNS[0].y;
+                pp.s = 0.f;
                 wi.idx = 1; // head toward waypoint #1 next frame
             }
         }
@@ -582,73 +995,58 @@ namespace element {
 
 void Element::wave_system() const {
     // 1) Find SpawnManager singleton
-    static const Mask mgrMask = MaskBuilder()
-            .set<SpawnManager_Tag>()
-            .set<SpawnState>()
-            .build();
-    ent_type mgr{-1};
-    for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-        if (World::mask(e).test(mgrMask)) {
-            mgr = e;
-            break;
-        }
-    }
+    ent_type mgr = World::singleton<SpawnManager_Tag>();
     if (mgr.id == -1) return;
+
+    // 2) A cleared wave hands back what its peak needed, once; bags may move, so this
+    //    runs before any component reference is taken
+    const bool creepsLeft = !World::view<Transform>().with<Creep_Tag>().empty();
+    if (const SpawnState done = World::getComponent<SpawnState>(mgr);
+        done.remaining == 0 && !creepsLeft && !done.cleared) {
+        World::shrink();
+        World::getComponent<SpawnState>(mgr).cleared = true;
+        if (opts.memoryReport)
+            printUsage(done.waveIndex);
+    }
     auto &st = World::getComponent<SpawnState>(mgr);
 
-    // 2) If we're mid-spawning this wave, continue countdown + spawn
+    // 3) If we're mid-spawning this wave, continue countdown + spawn
     if (st.remaining > 0) {
-        const Wave &w = WAVES[st.waveIndex];
+        const Wave w = waveAt(st.waveIndex);
         st.timeLeft -= DT;
         if (st.timeLeft <= 0.f) {
-            createCreep(w.speed, w.hp, w.gold, w.sprite);
-            st.remaining -= 1;
+            // no delay between creeps: the rest of the wave arrives together
+            const int count = w.delay > 0.f ? 1 : st.remaining;
+            createCreeps(count, w.speed, w.hp, w.gold, w.sprite);
+            st.remaining -= count;
             st.timeLeft = w.delay;
         }
         return;
     }
 
     // no new wave until current one’s creeps are all gone and player clicked
-    // 3) Ensure no creeps remain alive before allowing next-wave click
-    static const Mask creepMask = MaskBuilder().set<Creep_Tag>().build();
-    for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-        if (World::mask(e).test(creepMask))
-            return;
-    }
+    // 4) Ensure no creeps remain alive before allowing next-wave click
+    if (creepsLeft)
+        return;
 
-    // 4) Handle NextLevel click to start the next wave
-    static const Mask intentMask = MaskBuilder()
-            .set<GameState_Tag>()
-            .set<UIIntent>()
-            .build();
-    ent_type gs{-1};
-    for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-        if (World::mask(e).test(intentMask)) {
-            gs = e;
-            break;
-        }
-    }
+    // 5) Handle NextLevel click to start the next wave
+    ent_type gs = World::singleton<GameState_Tag>();
     if (gs.id == -1) return;
     auto &intent = World::getComponent<UIIntent>(gs);
     if (intent.action != UIAction::NextLevel)
         return;
 
-    // 5) Advance and initialize next wave
+    // 6) Advance and initialize next wave, with room for all of it up front
     st.waveIndex += 1;
-    if (st.waveIndex < WAVE_COUNT) {
-        const Wave &w = WAVES[st.waveIndex];
+    if (st.waveIndex < tables().waveCount) {
+        const Wave w = waveAt(st.waveIndex);
         st.remaining = w.count;
         st.timeLeft = 0.f;
+        st.cleared = false;
+        reserveFor<Transform, Drawable, WaypointIndex, PathProgress, Speed, HP, Gold_Bounty, Creep_Tag>(w.count);
 
         // ─────────── update the displayed level ───────────
-        static const Mask lvlMask = MaskBuilder()
-                .set<GameState_Tag>()
-                .set<CurrentLevel>()
-                .build();
-        ent_type levelEntity = findEntity(lvlMask);
-        if (levelEntity.id != -1) {
-            World::getComponent<CurrentLevel>(levelEntity).level = st.waveIndex + 1;
-        }
+        World::getComponent<CurrentLevel>(gs).level = st.waveIndex + 1;
     }
 
     // consume the UI intent
@@ -656,36 +1054,78 @@ void Element::wave_system() const {
 }
 
 
-    void Element::draw_system() const {
-        static const Mask mask = MaskBuilder()
-                .set<Transform>() // where to draw
-                .set<Drawable>() // what to draw
-                .build();
+    void Element::draw_system(float alpha) const {
+        constexpr float SNAP_SQ = 64.f * 64.f; // moved further in one step: teleport, don't blend
 
         SDL_RenderClear(ren);
-
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (!World::mask(e).test(mask))
-                continue;
-
-            const auto &d = World::getComponent<Drawable>(e);
-            const auto &t = World::getComponent<Transform>(e);
+        atlasSprites.begin(tex);
+        digitSprites.begin(digits);
+
+        // where to draw + what to draw
+        for (auto [e, t, d]: World::view<Transform, Drawable>()) {
+            // blend between the previous and the current tick
+            SDL_FPoint p = t.p;
+            float a = t.a;
+            if (const Transform *prev = previous.find(e)) {
+                const float dx = t.p.x - prev->p.x, dy = t.p.y - prev->p.y;
+                if (dx * dx + dy * dy < SNAP_SQ) {
+                    float da = t.a - prev->a;
+                    if (da > 180.f) da -= 360.f;
+                    if (da < -180.f) da += 360.f;
+                    p = {prev->p.x + dx * alpha, prev->p.y + dy * alpha};
+                    a = prev->a + da * alpha;
+                }
+            }
 
             const SDL_FRect dst = {
-                t.p.x - d.size.x / 2,
-                t.p.y - d.size.y / 2,
+                p.x - d.size.x / 2,
+                p.y - d.size.y / 2,
                 d.size.x, d.size.y
             };
-
-            SDL_RenderTextureRotated(
-                ren, tex, &d.part, &dst, t.a,
-                nullptr, SDL_FLIP_NONE);
+            const bool tinted = World::mask(e).test(Component<Tint>::Bit);
+            atlasSprites.add(d.part, dst, a, tinted ? World::getComponent<Tint>(e).color : SpriteBatch::WHITE);
         }
-
         print_status_bar();
+
+        // one draw call per texture, HUD digits on top
+        atlasSprites.submit(ren);
+        digitSprites.submit(ren);
+
+        // the profiler panel covers the HUD; its timings are a second digit batch above it
+        digitSprites.begin(digits);
+        profiler_overlay_system();
+        digitSprites.submit(ren);
         SDL_RenderPresent(ren);
     }
 
+    void Element::profiler_overlay_system() const {
+        if (!profiler.overlay) return;
+        constexpr float X = 30.f, Y = 30.f, ROW = 20.f, SCALE = 0.12f;
+        constexpr float COL[] = {170.f, 250.f, 330.f}; // p50, p99, max
+
+        // translucent panel under the whole table
+        const SDL_FRect panel{X - 10, Y - 10, 390.f, ROW * (Profiler::COUNT + 1) + 20};
+        SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 190);
+        SDL_RenderFillRect(ren, &panel);
+
+        // labels as debug text, timings (µs) with the digits texture
+        SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+        SDL_RenderDebugText(ren, X, Y + 4, "system (us)");
+        SDL_RenderDebugText(ren, X + COL[0], Y + 4, "p50");
+        SDL_RenderDebugText(ren, X + COL[1], Y + 4, "p99");
+        SDL_RenderDebugText(ren, X + COL[2], Y + 4, "max");
+        for (int i = 0; i < Profiler::COUNT; ++i) {
+            const float y = Y + ROW * static_cast<float>(i + 1);
+            const auto st = profiler.stats(static_cast<Profiler::System>(i));
+            SDL_RenderDebugText(ren, X, y + 4, Profiler::NAMES[i]);
+            drawScore(static_cast<int>(st.p50), X + COL[0], y, SCALE);
+            drawScore(static_cast<int>(st.p99), X + COL[1], y, SCALE);
+            drawScore(static_cast<int>(st.max), X + COL[2], y, SCALE);
+        }
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255); // clear colour
+    }
+
     void Element::drawScore(int score, float x, float y, float scale /*=1.0f*/) const {
         std::string s = std::to_string(score);
         float cx = x;
@@ -722,41 +1162,20 @@ void Element::wave_system() const {
             dst.w = frame.w * scale;
             dst.h = frame.h * scale;
 
-            SDL_RenderTexture(ren, digits, &src, &dst);
+            digitSprites.add(src, dst, 0.f);
             cx += frame.w * scale; // spacing for next digit
         }
     }
 
     void Element::print_status_bar() const {
         // HP and Gold from player
-        static const Mask uiMask = MaskBuilder()
-                .set<Player_Tag>()
-                .set<HP>()
-                .set<Gold>()
-                .build();
-        ent_type player{-1};
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (World::mask(e).test(uiMask)) {
-                player = e;
-                break;
-            }
-        }
+        ent_type player = World::singleton<Player_Tag>();
         if (player.id == -1) return;
         int hp = World::getComponent<HP>(player).current;
         int gold = World::getComponent<Gold>(player).current;
 
         // Current level from GameState
-        static const Mask lvlMask = MaskBuilder()
-                .set<GameState_Tag>()
-                .set<CurrentLevel>()
-                .build();
-        ent_type gs{-1};
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (World::mask(e).test(lvlMask)) {
-                gs = e;
-                break;
-            }
-        }
+        ent_type gs = World::singleton<GameState_Tag>();
         int level = (gs.id != -1)
                         ? World::getComponent<CurrentLevel>(gs).level
                         : 0;
@@ -770,117 +1189,47 @@ void Element::wave_system() const {
     }
 
     void Element::targeting_system() const {
-        // Mask for towers that can target
-        static const Mask towerMask = MaskBuilder()
-                .set<Transform>()
-                .set<Range>()
-                .set<Target>()
-                .build();
-
-        // Mask for alive creeps with a known waypoint
-        static const Mask creepMask = MaskBuilder()
-                .set<Creep_Tag>()
-                .set<Transform>()
-                .set<WaypointIndex>()
-                .build();
-
-        // For each tower…
-        for (ent_type t{0}; t.id <= World::maxId().id; ++t.id) {
-            if (!World::mask(t).test(towerMask))
-                continue;
-
-            auto &tgt = World::getComponent<Target>(t);
-            const auto &tp = World::getComponent<Transform>(t).p;
-            float range = World::getComponent<Range>(t).value;
-            float rangeSq = range * range;
-
-            // 1) If we already have a target, check validity
-            if (tgt.id != -1) {
-                ent_type old{tgt.id};
-                if (!World::mask(old).test(creepMask)) {
-                    tgt.id = -1;
-                } else {
-                    const auto &cp = World::getComponent<Transform>(old).p;
-                    float dx = cp.x - tp.x, dy = cp.y - tp.y;
-                    if (dx * dx + dy * dy > rangeSq)
-                        tgt.id = -1;
-                }
+        // 0) Bucket alive creeps with their path progress, once for all towers
+        creepGrid.clear();
+        for (auto [c, ct, pp]: World::view<Transform, PathProgress>().with<Creep_Tag>())
+            creepGrid.insert(c, ct.p, pp.s);
+        creepGrid.build(furtherAlong);
+
+        // For each tower that can target…
+        const auto towers = World::view<Transform, Range, Target>();
+        parallel_for(towers, TOWER_GRAIN, [](ent_type, auto tr, Range &rg, Target &tgt) {
+            const auto &tp = tr.p;
+            float rangeSq = rg.value * rg.value;
+
+            // 1) If we already have a target, check it is still alive and in range
+            if (World::alive(tgt.e)) {
+                const auto &cp = World::getComponent<Transform>(tgt.e).p;
+                float dx = cp.x - tp.x, dy = cp.y - tp.y;
+                if (dx * dx + dy * dy > rangeSq)
+                    tgt.e = ent_type{-1};
+            } else {
+                tgt.e = ent_type{-1};
             }
 
-            // 2) If no valid target, search for the furthest‐along creep in range
-            if (tgt.id == -1) {
-                float bestScore = -1.0f;
-                float bestSubDist = std::numeric_limits<float>::infinity();
-                ent_type bestCreep = ent_type{-1};
-
-                for (ent_type c{0}; c.id <= World::maxId().id; ++c.id) {
-                    if (!World::mask(c).test(creepMask))
-                        continue;
-
-                    const auto &cp = World::getComponent<Transform>(c).p;
-                    float dx = cp.x - tp.x, dy = cp.y - tp.y;
-                    if (dx * dx + dy * dy > rangeSq)
-                        continue;
-
-                    int idx = World::getComponent<WaypointIndex>(c).idx;
-                    float score = static_cast<float>(idx);
-
-                    if (score > bestScore) {
-                        // strictly better index
-                        bestScore = score;
-                        bestCreep = c;
-                        // compute distance squared to the *next* waypoint
-                        const auto &nx = TURNS[idx].x;
-                        const auto &ny = TURNS[idx].y;
-                        float sx = nx - cp.x, sy = ny - cp.y;
-                        bestSubDist = sx * sx + sy * sy;
-                    } else if (score == bestScore) {
-                        // tie: pick the one closer to next waypoint
-                        const auto &nx = TURNS[idx].x;
-                        const auto &ny = TURNS[idx].y;
-                        float sx = nx - cp.x, sy = ny - cp.y;
-                        float subDist = sx * sx + sy * sy;
-                        if (subDist < bestSubDist) {
-                            bestSubDist = subDist;
-                            bestCreep = c;
-                        }
-                    }
-                }
-
-                tgt.id = bestCreep.id;
+            // 2) If no valid target, take the furthest‐along creep in range
+            if (tgt.e.id == -1) {
+                const CreepGrid::Entry *best = creepGrid.queryBest(tp, rg.value, furtherAlong);
+                tgt.e = best ? best->e : ent_type{-1};
             }
-        }
+        });
     }
 
     void Element::shooting_system() const {
-        static const Mask towerMask = MaskBuilder()
-                .set<Transform>()
-                .set<Damage>()
-                .set<FireRate>()
-                .set<Target>()
-                .build();
-        static const Mask creepMask = MaskBuilder()
-                .set<Transform>()
-                .set<Creep_Tag>()
-                .build();
-
-        for (ent_type t{0}; t.id <= World::maxId().id; ++t.id) {
-            if (!World::mask(t).test(towerMask)) continue;
-
-            auto &fr = World::getComponent<FireRate>(t);
-            auto &tgt = World::getComponent<Target>(t);
-
+        for (auto [t, fr, tgt]: World::view<FireRate, Target>().with<Transform, Damage>()) {
             // 1) Cooldown tick
             if (fr.timeLeft > 0.f) {
                 fr.timeLeft -= DT;
                 continue;
             }
             // 2) No valid target?
-            if (tgt.id == -1) continue;
-
-            ent_type creep{tgt.id};
-            if (!World::mask(creep).test(creepMask)) {
-                tgt.id = -1;
+            ent_type creep = tgt.e;
+            if (!World::alive(creep)) {
+                tgt.e = ent_type{-1};
                 continue;
             }
 
@@ -888,10 +1237,9 @@ void Element::wave_system() const {
             const auto &srcPt = World::getComponent<Transform>(t).p;
             const auto &dstPt = World::getComponent<Transform>(creep).p;
             int dmg = World::getComponent<Damage>(t).value;
-            int tid = tgt.id;
 
             // 4) Spawn the bullet
-            createBullet(srcPt, dstPt, dmg, tid);
+            createBullet(srcPt, dstPt, dmg, creep);
 
             // 5) Reset the fire‐rate timer
             fr.timeLeft = fr.interval;
@@ -900,33 +1248,18 @@ void Element::wave_system() const {
 
     void Element::homing_system() const {
         // Only bullets that still have a Target and a Velocity get updated
-        static const Mask mask = MaskBuilder()
-                .set<Bullet_Tag>()
-                .set<Velocity>()
-                .set<Target>()
-                .build();
-        static const Mask creepMask = MaskBuilder()
-                .set<Creep_Tag>()
-                .set<Transform>()
-                .build();
-
-        // Match the speed you used in createBullet()
-        for (ent_type b{0}; b.id <= World::maxId().id; ++b.id) {
-            if (!World::mask(b).test(mask)) continue;
-
-            auto &tgt = World::getComponent<Target>(b);
-            auto &vel = World::getComponent<Velocity>(b);
-            const auto &src = World::getComponent<Transform>(b).p;
+        const auto bullets = World::view<Target, Velocity, Transform>().with<Bullet_Tag>();
+        for (auto [b, tgt, vel, bt]: bullets) {
+            const auto &src = bt.p;
 
             // If the target’s gone or died, just destroy the bullet
-            ent_type creep{tgt.id};
-            if (!World::mask(creep).test(creepMask)) {
-                World::destroyEntity(b);
+            if (!World::alive(tgt.e)) {
+                homingCommands.destroy(b);
                 continue;
             }
 
             // Re-aim toward the creep’s current position
-            const auto &dst = World::getComponent<Transform>(creep).p;
+            const auto &dst = World::getComponent<Transform>(tgt.e).p;
             float dx = dst.x - src.x;
             float dy = dst.y - src.y;
             float dist = SDL_sqrtf(dx * dx + dy * dy);
@@ -940,50 +1273,109 @@ void Element::wave_system() const {
     }
 
     void Element::bullet_hit_system() const {
-        static const Mask mask = MaskBuilder()
-                .set<Bullet_Tag>()
-                .set<TravelTime>()
-                .set<Target>()
-                .set<Damage>()
-                .build();
-
-        static const Mask creepMask = MaskBuilder()
-                .set<Creep_Tag>()
-                .set<Transform>()
-                .set<HP>()
-                .build();
-
-        for (ent_type b{0}; b.id <= World::maxId().id; ++b.id) {
-            if (!World::mask(b).test(mask))
-                continue;
-
-            auto &tt = World::getComponent<TravelTime>(b);
+        const auto bullets = World::view<TravelTime, Target, Damage>().with<Bullet_Tag>();
+        for (auto [b, tt, tgt, dmg]: bullets) {
             tt.travelTime -= DT;
             if (tt.travelTime > 0.f)
                 continue; // not yet at center
 
             // now we’ve reached the creep’s center
-            auto &tgt = World::getComponent<Target>(b);
-            ent_type creep{tgt.id};
-            if (World::mask(creep).test(creepMask)) {
+            ent_type creep = tgt.e;
+            if (World::alive(creep)) {
                 auto &hp = World::getComponent<HP>(creep);
-                hp.current -= World::getComponent<Damage>(b).value;
+                hp.current -= dmg.value;
                 if (hp.current <= 0)
-                    World::destroyEntity(creep);
+                    bulletHitCommands.destroy(creep);
             }
-            World::destroyEntity(b);
+            bulletHitCommands.destroy(b);
+        }
+    }
+
+
+    // components and resources each logic system reads and writes, for the scheduler
+    static Access logicAccess(int i) {
+        // @formatter:off
+        switch (Profiler::Ui + i) {
+            case Profiler::Ui:
+                return Access::of(Reads<MouseInput, Transform, Drawable, UIButton_Tag>{}, Writes<UIIntent>{});
+            case Profiler::PlacingTower: // createTower
+                return Access::of(Reads<MouseInput>{}, Writes<Drawable, Tint, UIIntent, Resource<TileGrid>>{}, Access::Structural);
+            case Profiler::Wave:         // createCreeps
+                return Access::of(Reads<Transform, Creep_Tag>{}, Writes<SpawnState, UIIntent, CurrentLevel>{}, Access::Structural);
+            case Profiler::PathNavigation:
+                return Access::of(Reads<Speed, Creep_Tag>{}, Writes<Transform, PathProgress, WaypointIndex>{});
+            case Profiler::Endpoint:
+                return Access::of(Reads<Gold_Bounty, Creep_Tag>{}, Writes<HP, Gold, Transform, PathProgress, WaypointIndex>{});
+            case Profiler::Targeting:
+                return Access::of(Reads<Transform, PathProgress, Range, Creep_Tag>{}, Writes<Target, Resource<CreepGrid>>{});
+            case Profiler::Shooting:
+                return Access::of(Reads<Transform, Damage>{}, Writes<FireRate, Target, Resource<Volley>>{});
+            case Profiler::Homing:
+                return Access::of(Reads<Target, Transform, Bullet_Tag>{}, Writes<Velocity, Resource<HomingCommands>>{});
+            case Profiler::BulletHit:
+                return Access::of(Reads<Target, Damage, Bullet_Tag>{}, Writes<TravelTime, HP, Resource<BulletHitCommands>>{});
+            case Profiler::Movement:
+                return Access::of(Reads<Velocity>{}, Writes<Transform>{});
+            default:                     // flush
+                return Access::of(Reads<>{}, Writes<>{}, Access::Structural);
         }
+        // @formatter:on
     }
 
+    static Scheduler scheduler;
 
     /// game
-    Element::Element() {
-        if (!prepareWindowAndTexture()) return;
+    std::vector<InputEvent> loadInputScript(const char *path) {
+        std::vector<InputEvent> script;
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "cannot open input script " << path << std::endl;
+            return script;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            InputEvent ev{};
+            int clicked = 0;
+            if (fields >> ev.frame >> ev.x >> ev.y >> clicked) {
+                ev.clicked = clicked != 0;
+                script.push_back(ev);
+            }
+        }
+        return script;
+    }
+
+    Element::Element(Options opts) : opts(std::move(opts)) {
+        std::stable_sort(this->opts.script.begin(), this->opts.script.end(),
+                         [](const InputEvent &a, const InputEvent &b) { return a.frame < b.frame; });
+        if (this->opts.profileCsv != nullptr)
+            profiler.openCsv(this->opts.profileCsv);
+        if (this->opts.record != nullptr && !recorder.open(this->opts.record, FPS))
+            std::cerr << "cannot write replay " << this->opts.record << std::endl;
+        if (!mapTiles.load("res/flash_elemnt_map.txt"))
+            std::cerr << "res/flash_elemnt_map.txt missing or malformed, road not blocked" << std::endl;
+        if (this->opts.replay != nullptr)
+            this->opts.headless = true;
+        if (!this->opts.headless && !prepareWindowAndTexture()) return;
         createUI();
         createPlayer();
         createMouse();
         createGameState();
         createSpawnManager();
+
+        // step(): the logic systems, independent ones concurrently when given threads
+        scheduler.clear();
+        for (int i = 0; i < LOGIC_SYSTEM_COUNT; ++i)
+            scheduler.add(logicAccess(i), [this, i] {
+                Profiler::Scope s(profiler, static_cast<Profiler::System>(Profiler::Ui + i));
+                runLogicSystem(i);
+            });
+        // opts.threads is the number of extra threads in all: half of them run independent
+        // systems side by side, the rest split the parallel_for loops
+        const int systemWorkers = this->opts.threads / 2;
+        scheduler.start(systemWorkers);
+        Jobs::start(this->opts.threads - systemWorkers);
     }
 
     Element::~Element() {
@@ -997,33 +1389,185 @@ void Element::wave_system() const {
         SDL_Quit();
     }
 
-    [[noreturn]] void Element::run() {
-        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-        auto start = SDL_GetTicks();
-        while (true) {
-            input_system();
-            ui_system();
-            placing_tower_system();
+    // logic systems are the profiler's, Ui through Movement
+    static_assert(Profiler::Movement - Profiler::Ui + 1 == Element::LOGIC_SYSTEM_COUNT);
+
+    const char *Element::logicSystemName(int i) {
+        return Profiler::NAMES[Profiler::Ui + i];
+    }
+
+    void Element::runLogicSystem(int i) const {
+        // @formatter:off
+        switch (Profiler::Ui + i) {
+            case Profiler::Ui:              ui_system(); break;
+            case Profiler::PlacingTower:    placing_tower_system(); break;
 
-            wave_system();
-            path_navigation_system();
-            endpoint_system();
+            case Profiler::Wave:            wave_system(); break;
+            case Profiler::PathNavigation:  path_navigation_system(); break;
+            case Profiler::Endpoint:        endpoint_system(); break;
 
-            targeting_system();
-            shooting_system();
-            homing_system();
+            case Profiler::Targeting:       targeting_system(); break;
+            case Profiler::Shooting:        shooting_system(); break;
+            case Profiler::Homing:          homing_system(); break;
             // damage_system();
-            bullet_hit_system();
+            case Profiler::BulletHit:       bullet_hit_system(); break;
+            case Profiler::Flush:           // in recording order, as one buffer would
+                volley.flush();
+                homingCommands.flush();
+                bulletHitCommands.flush();
+                break;
 
-            movement_system();
-            draw_system();
+            case Profiler::Movement:        movement_system(); break;
+            default: break;
+        }
+        // @formatter:on
+    }
+
+    void Element::step() const {
+        scheduler.run();
+    }
+
+    void Element::populate(int creeps, int towers) const {
+        // 1) creeps that never die, spread over the whole path
+        for (int i = 0; i < CREEP_TEX_COUNT; ++i)
+            createCreeps(creeps / CREEP_TEX_COUNT + (i < creeps % CREEP_TEX_COUNT),
+                         CREEP_SPEED, std::numeric_limits<int>::max() / 2, 1, CREEP_TEX[i]);
+        int i = 0;
+        for (auto [e, pp, wi]: World::view<PathProgress, WaypointIndex>().with<Creep_Tag>()) {
+            pp.s = PATH_LENGTH * (static_cast<float>(i++) + 0.5f) / static_cast<float>(creeps);
+            wi.idx = 1;
+        }
+        path_navigation_system(); // way-points and positions for the new progress
+
+        // 2) every free footprint touching the road, on a copy so the real map stays empty
+        TileGrid tiles = mapTiles;
+        std::vector<SDL_Point> spots;
+        for (int r = 0; r + TileGrid::FOOTPRINT <= MAP_ROWS; ++r)
+            for (int c = 0; c + TileGrid::FOOTPRINT <= MAP_COLS; ++c) {
+                if (!tiles.canPlace({c, r})) continue;
+                bool road = false;
+                for (int y = std::max(0, r - 1); y < std::min(MAP_ROWS, r + TileGrid::FOOTPRINT + 1); ++y)
+                    for (int x = std::max(0, c - 1); x < std::min(MAP_COLS, c + TileGrid::FOOTPRINT + 1); ++x)
+                        road |= tiles.isRoad(x, y);
+                if (!road) continue;
+                tiles.place({c, r}, ent_type{-1});
+                spots.push_back({c, r});
+            }
+        if (spots.empty()) return;
+
+        // 3) towers cycle through the buyable kinds, spots are reused once all are taken
+        constexpr TowerKind KINDS[] = {TowerKind::Arrow, TowerKind::Cannon, TowerKind::Air};
+        const SDL_FRect SPRITES[] = {TOWER_TEX_ARROW, TOWER_TEX_CANNON, TOWER_TEX_AIR};
+        for (int t = 0; t < towers; ++t) {
+            const TowerStats &stats = tables().tower(KINDS[t % 3], 1);
+            const SDL_FPoint at = TileGrid::footprintCenter(spots[t % spots.size()]);
+            createTower(at.x, at.y, stats.range * TEX_SCALE, stats.damage, stats.fireInterval, SPRITES[t % 3]);
+        }
+    }
+
+    int Element::playback(const char *path) const {
+        replay::Reader in;
+        if (!in.open(path) || in.ticksPerSecond() != FPS) {
+            std::cerr << path << " is not a replay recorded at " << FPS << " ticks/s" << std::endl;
+            return 1;
+        }
+        const ent_type mouse = World::singleton<Mouse_Tag>(), gs = World::singleton<GameState_Tag>();
+        if (mouse.id == -1 || gs.id == -1) return 1;
+
+        // feed every recorded tick back through the systems, no rendering, no delay
+        const auto wallStart = SDL_GetPerformanceCounter();
+        replay::Tick tick{};
+        int ticks = 0;
+        while (in.next(tick)) {
+            auto &mi = World::getComponent<MouseInput>(mouse);
+            auto t = World::getComponent<Transform>(mouse);
+            mi = tick.mouse;
+            t.p = {static_cast<float>(mi.x), static_cast<float>(mi.y)};
+            World::getComponent<UIIntent>(gs).action = tick.intent;
+
+            step();
+            profiler.endFrame();
+            if (const Uint32 h = replay::worldHash(); h != tick.hash) {
+                std::cerr << "replay desync at tick " << ticks << ": hash " << std::hex << h
+                          << ", recorded " << tick.hash << std::dec << std::endl;
+                return 1;
+            }
+            ++ticks;
+        }
 
-            const auto end = SDL_GetTicks();
-            if (const auto elapsed = end - start;
-                static_cast<float>(elapsed) < GAME_FRAME) {
-                SDL_Delay(static_cast<Uint32>(GAME_FRAME - static_cast<float>(elapsed)));
+        const double wall = static_cast<double>(SDL_GetPerformanceCounter() - wallStart) /
+                            static_cast<double>(SDL_GetPerformanceFrequency());
+        cout << "replay: " << ticks << " ticks in sync, " << ticks * static_cast<double>(DT)
+             << " simulated s in " << wall << " wall s" << endl;
+        return 0;
+    }
+
+    int Element::run() {
+        if (opts.replay != nullptr)
+            return playback(opts.replay);
+
+        if (opts.headless) {
+            // as fast as the CPU allows, no rendering
+            const auto wallStart = SDL_GetPerformanceCounter();
+            for (int frame = 0; frame < opts.frames; ++frame) {
+                {
+                    Profiler::Scope s(profiler, Profiler::Input);
+                    scripted_input_system(frame);
+                }
+                recordInput();
+                step();
+                recordHash();
+                profiler.endFrame();
+            }
+            const double wall = static_cast<double>(SDL_GetPerformanceCounter() - wallStart) /
+                                static_cast<double>(SDL_GetPerformanceFrequency());
+            const double simulated = opts.frames * static_cast<double>(DT);
+            cout << "headless: " << opts.frames << " steps, " << simulated << " simulated s in "
+                 << wall << " wall s (" << simulated / wall << " sim-s/wall-s)" << endl;
+            return 0;
+        }
+
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+        const double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+        Uint64 last = SDL_GetPerformanceCounter();
+        double accumulator = 0;
+        while (true) {
+            const Uint64 now = SDL_GetPerformanceCounter();
+            accumulator += static_cast<double>(now - last) / freq;
+            last = now;
+
+            // 1) run as many fixed steps as the elapsed time asks for, bounded so a
+            //    slow frame drops time instead of spiralling
+            int steps = 0;
+            while (accumulator >= DT && steps < MAX_CATCHUP_STEPS) {
+                previous.capture();
+                {
+                    Profiler::Scope s(profiler, Profiler::Input);
+                    input_system();
+                }
+                recordInput();
+                step();
+                recordHash();
+                accumulator -= DT;
+                ++steps;
+            }
+            if (steps == MAX_CATCHUP_STEPS && accumulator >= DT)
+                accumulator = 0;
+
+            // 2) render between the last two ticks
+            {
+                Profiler::Scope s(profiler, Profiler::Draw);
+                draw_system(static_cast<float>(accumulator / DT));
+            }
+            profiler.endFrame();
+
+            // 3) capped: sleep until the next step is due
+            if (!opts.uncapped) {
+                const double ahead = DT - accumulator -
+                                     static_cast<double>(SDL_GetPerformanceCounter() - last) / freq;
+                if (ahead > 0)
+                    SDL_DelayPrecise(static_cast<Uint64>(ahead * 1e9));
             }
-            start += static_cast<Uint64>(GAME_FRAME);
         }
     }
 }
@@ -1,58 +1,95 @@
 #pragma once
 #include <SDL3/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
 #include "res/atlas.h"
+#include "Tables.h"
 
 #define FRECT(s) SDL_FRect{ (s).x, (s).y, (s).w, (s).h }
 
+namespace bagel { struct ent_type; }
+
 // @formatter:off
 namespace element {
     enum class UIAction {None, BuyArrow, BuyCannon, BuyAir, NextLevel};
 
     /// components
-    using Transform = struct {SDL_FPoint p; float a;};
-    using Drawable = struct {SDL_FRect part; SDL_FPoint size;};
-    using Gold = struct {int current;};
-    using HP = struct {int current; int initial;};
-    using Gold_Bounty = struct {int value;};
-    using Speed = struct {float value;};
-    using Velocity  = struct { SDL_FPoint v; };          // vector per second
-    using WaypointIndex = struct { int idx; };          // next target in TURNS[]
-    using CurrentLevel = struct { int level; };         // which entry in WAVES[]
-    using SpawnState = struct {int waveIndex; int remaining; float timeLeft;};
-    using MouseInput = struct {int x; int y; bool clicked;};
-    using UIIntent = struct {UIAction action = UIAction::None;};
-    using Range = struct {float value;};
-    using Damage = struct {int value;};
-    using FireRate = struct {float interval; float timeLeft;};
-    using Target = struct {int id;};
-    using TravelTime = struct {float travelTime;};
+    struct Transform {SDL_FPoint p; float a;};
+    struct Drawable {SDL_FRect part; SDL_FPoint size;};
+    struct Gold {int current;};
+    struct HP {int current; int initial;};
+    struct Gold_Bounty {int value;};
+    struct Speed {float value;};
+    struct Velocity { SDL_FPoint v; };          // vector per second
+    struct WaypointIndex { int idx; };          // next target in TURNS[]
+    struct PathProgress { float s; };           // distance travelled along the path
+    struct CurrentLevel { int level; };         // 1-based wave number shown in the HUD
+    struct SpawnState {int waveIndex; int remaining; float timeLeft; bool cleared;}; // cleared: storages shrunk since the last wave
+    struct MouseInput {int x; int y; bool clicked;};
+    struct UIIntent {UIAction action = UIAction::None;};
+    struct Range {float value;};
+    struct Damage {int value;};
+    struct FireRate {float interval; float timeLeft;};
+    template <class Ent> struct Handle {Ent e;};   // Ent completes once bagel.h is included
+    using Target = Handle<bagel::ent_type>;         // generational, check World::alive
+    struct TravelTime {float travelTime;};
+    struct Tint {SDL_FColor color;};              // vertex colour multiplied into the sprite
 
     /// Tags
-    using Creep_Tag = struct {};
-    using Player_Tag = struct {};
-    using Mouse_Tag = struct {};
-    using UIButton_Tag = struct {};
-    using HUD_Tag = struct {};
-    using Arrow_Tag = struct {};
-    using Cannon_Tag = struct {};
-    using Air_Tag = struct {};
-    using NextLevel_Tag = struct {};
-    using GameState_Tag = struct {};
-    using SpawnManager_Tag = struct {};
-    using Bullet_Tag = struct {};
-    using CoinIcon_Tag  = struct {};
-    using HealthIcon_Tag= struct {};
+    struct Creep_Tag {};
+    struct Player_Tag {};
+    struct Mouse_Tag {};
+    struct UIButton_Tag {};
+    struct HUD_Tag {};
+    struct Arrow_Tag {};
+    struct Cannon_Tag {};
+    struct Air_Tag {};
+    struct NextLevel_Tag {};
+    struct GameState_Tag {};
+    struct SpawnManager_Tag {};
+    struct Bullet_Tag {};
+    struct CoinIcon_Tag {};
+    struct HealthIcon_Tag {};
+
+    /// scripted mouse input, replaces SDL events in headless runs
+    struct InputEvent {int frame; int x; int y; bool clicked;};
+    std::vector<InputEvent> loadInputScript(const char *path); // lines of "frame x y clicked"
+
+    struct Options {
+        bool headless = false;          // no window, renderer or frame delay
+        int frames = 3600;              // headless: logic steps to simulate
+        std::vector<InputEvent> script; // headless: input source
+        const char *profileCsv = nullptr; // per-frame system timings, nullptr = off
+        bool uncapped = false;          // render as often as possible instead of once per step
+        const char *record = nullptr;   // write every tick's input + world hash to this replay file
+        const char *replay = nullptr;   // play this replay back headless and check its hashes
+        int threads = 0;                // extra threads, shared by scheduler and parallel_for; 0 runs everything serially
+        bool memoryReport = false;      // print every storage's usage and high-water mark once a wave is cleared
+    };
 
     class Element {
     public:
-        Element();
+        explicit Element(Options opts = {});
         ~Element();
 
-        [[noreturn]] void run(); // main loop
+        int run(); // main loop, returns (an exit status) only in headless and replay mode
+        void step() const; // one fixed-DT tick of every logic system
+
+        /// stress harness (BAGEL_bench)
+        static constexpr int LOGIC_SYSTEM_COUNT = 11;
+        static const char *logicSystemName(int i); // step() order; "flush" applies the deferred commands
+        void runLogicSystem(int i) const;
+        // `creeps` spread evenly over the path, `towers` on the grass beside it (stacked once it is full)
+        void populate(int creeps, int towers) const;
 
         static constexpr float MAP_TEX_PAD_X = 20.0f;
         static constexpr float MAP_TEX_PAD_Y = 20.0f;
         static constexpr float TEX_SCALE = 1.8f;
+        static constexpr int MAP_COLS = 32; // tile grid of res/flash_elemnt_map.txt
+        static constexpr int MAP_ROWS = 34;
 
         static constexpr SDL_FRect SHEEP_TEX = {
             sprite_1.x + 5, sprite_1.y, sprite_1.w, sprite_1.h};
@@ -78,14 +115,17 @@ namespace element {
         void createGameState() const;
         void createSpawnManager() const;
         //factories
-        void createCreep(float speed, int hp, int goldBounty, SDL_FRect spriteRect) const;
-        void createTower(float x, float y, float range, int healthDamage,
+        void createCreeps(int count, float speed, int hp, int goldBounty, SDL_FRect spriteRect) const;
+        bagel::ent_type createTower(float x, float y, float range, int healthDamage,
                              float fire_rate, SDL_FRect spriteRect) const;
         void createBullet(const SDL_FPoint &src, const SDL_FPoint &dst,
-                                int damage, int targetId) const;
+                                int damage, bagel::ent_type target) const;
+
+        int playback(const char *path) const;
 
         /// systems
         void input_system()             const;
+        void scripted_input_system(int frame) const;
         void ui_system()                const;
         void path_navigation_system()   const;
         void movement_system()          const;
@@ -100,7 +140,8 @@ namespace element {
         void shooting_system()          const;
         void homing_system()            const;
         void bullet_hit_system()        const;
-        void draw_system()              const;
+        void draw_system(float alpha)   const; // alpha: fraction of a step since the last tick
+        void profiler_overlay_system()  const;
 
         void drawScore(int score, float x, float y, float scale) const;
 
@@ -109,7 +150,7 @@ namespace element {
 
         static constexpr int FPS = 60;
         static constexpr float DT = 1.f / FPS; // seconds per logic step (0.016 666…)
-        static constexpr float GAME_FRAME = 1000.f / FPS;
+        static constexpr int MAX_CATCHUP_STEPS = 5; // logic steps per rendered frame before we drop time
         static constexpr float RAD_TO_DEG = 57.2958f;
 
         static constexpr SDL_FRect MAP_TEX              = FRECT(sprite_map);
@@ -129,6 +170,7 @@ namespace element {
         static constexpr SDL_FRect UI_LEVEL_TEX         = FRECT(sprite_ui_level);
 
 
+        Options opts;
         SDL_Window *win = nullptr;
         SDL_Renderer *ren = nullptr;
         SDL_Texture *tex = nullptr;
@@ -172,11 +214,251 @@ namespace element {
 
     constexpr int TURN_COUNT = sizeof(TURNS) / sizeof(TURNS[0]);
 
+    constexpr float constSqrt(float v) {
+        float r = v > 1.f ? v : 1.f;
+        for (int i = 0; i < 32; ++i) r = 0.5f * (r + v / r);
+        return r;
+    }
+
+    // Arc-length table: s[i] is the distance from TURNS[0] to TURNS[i],
+    // dir[i] the unit vector of the segment that ends at TURNS[i]
+    struct PathTable {float s[TURN_COUNT]; SDL_FPoint dir[TURN_COUNT];};
+
+    constexpr PathTable makePath() {
+        PathTable t{};
+        for (int i = 1; i < TURN_COUNT; ++i) {
+            const float dx = TURNS[i].x - TURNS[i - 1].x, dy = TURNS[i].y - TURNS[i - 1].y;
+            const float len = constSqrt(dx * dx + dy * dy);
+            t.s[i] = t.s[i - 1] + len;
+            t.dir[i] = {dx / len, dy / len};
+        }
+        return t;
+    }
+
+    constexpr PathTable PATH = makePath();
+    constexpr float PATH_LENGTH = PATH.s[TURN_COUNT - 1];
+
     // -----------------------------------------------------------------------------
     // (end waypoint helpers)
     // -----------------------------------------------------------------------------
 
 
+    // -----------------------------------------------------------------------------
+    // Uniform spatial hash (resource, rebuilt every frame)
+    // -----------------------------------------------------------------------------
+    // Entries are bucketed by cell with a counting sort, so the cells of one grid
+    // row are contiguous and a circle query walks one span per covered row.
+    template <class Ent, class Data = int>
+    class SpatialGridOf {
+    public:
+        struct Entry {Ent e; SDL_FPoint p; Data data;};
+
+        SpatialGridOf(SDL_FRect bounds, int cols, int rows)
+            : bounds(bounds), cols(cols), rows(rows),
+              cellW(bounds.w / static_cast<float>(cols)), cellH(bounds.h / static_cast<float>(rows)),
+              start(cols * rows + 1, 0) {}
+
+        void clear() { pending.clear(); }
+        void insert(Ent e, SDL_FPoint p, Data data) {
+            pending.push_back({row(p.y) * cols + col(p.x), {e, p, data}});
+        }
+        void build() {
+            std::fill(start.begin(), start.end(), 0);
+            for (const auto &c: pending) ++start[c.cell + 1];
+            for (size_t i = 1; i < start.size(); ++i) start[i] += start[i - 1];
+
+            entries.resize(pending.size());
+            fill.assign(start.begin(), start.end() - 1);
+            for (const auto &c: pending) entries[fill[c.cell]++] = c.entry;
+        }
+        // as build(), then orders every cell by `before` (ties keep insertion order) and
+        // boxes each run of BLOCK entries, so queryBest can skip runs off the circle
+        template <class Less>
+        void build(Less before) {
+            build();
+            boxStart.assign(start.size(), 0);
+            boxes.clear();
+            for (size_t c = 0; c + 1 < start.size(); ++c) {
+                std::stable_sort(entries.begin() + start[c], entries.begin() + start[c + 1], before);
+                for (int i = start[c]; i < start[c + 1]; i += BLOCK) {
+                    Box b{entries[i].p.x, entries[i].p.y, entries[i].p.x, entries[i].p.y};
+                    for (int j = i + 1, end = std::min(i + BLOCK, start[c + 1]); j < end; ++j) {
+                        b.x0 = std::min(b.x0, entries[j].p.x); b.x1 = std::max(b.x1, entries[j].p.x);
+                        b.y0 = std::min(b.y0, entries[j].p.y); b.y1 = std::max(b.y1, entries[j].p.y);
+                    }
+                    boxes.push_back(b);
+                }
+                boxStart[c + 1] = static_cast<int>(boxes.size());
+            }
+        }
+
+        // calls f(entry) for every entry within r of center
+        template <class F>
+        void queryCircle(SDL_FPoint center, float r, F &&f) const {
+            const float rSq = r * r;
+            const int c0 = col(center.x - r), c1 = col(center.x + r);
+            for (int y = row(center.y - r), y1 = row(center.y + r); y <= y1; ++y) {
+                for (int i = start[y * cols + c0], end = start[y * cols + c1 + 1]; i < end; ++i) {
+                    const Entry &en = entries[i];
+                    const float dx = en.p.x - center.x, dy = en.p.y - center.y;
+                    if (dx * dx + dy * dy <= rSq)
+                        f(en);
+                }
+            }
+        }
+        // the entry within r of center that comes first by `before`, nullptr if none. Needs
+        // build(before): covered cells are visited by their first entry, and a cell's scan
+        // stops at the first entry that can't beat the best so far
+        template <class Less>
+        const Entry *queryBest(SDL_FPoint center, float r, Less before) const {
+            thread_local std::vector<int> cells;
+            cells.clear();
+            const int c0 = col(center.x - r), c1 = col(center.x + r);
+            for (int y = row(center.y - r), y1 = row(center.y + r); y <= y1; ++y)
+                for (int cell = y * cols + c0, last = y * cols + c1; cell <= last; ++cell)
+                    if (start[cell] < start[cell + 1])
+                        cells.push_back(cell);
+            std::stable_sort(cells.begin(), cells.end(), [&](int a, int b) {
+                return before(entries[start[a]], entries[start[b]]);
+            });
+
+            const float rSq = r * r;
+            const Entry *best = nullptr;
+            for (const int cell: cells) {
+                if (best && !before(entries[start[cell]], *best))
+                    break; // no later cell starts any higher
+                for (int b = boxStart[cell], i = start[cell], end = start[cell + 1]; i < end; ++b, i += BLOCK) {
+                    if (best && !before(entries[i], *best))
+                        break;
+                    const Box &box = boxes[b];
+                    const float bx = std::max({box.x0 - center.x, 0.f, center.x - box.x1});
+                    const float by = std::max({box.y0 - center.y, 0.f, center.y - box.y1});
+                    if (bx * bx + by * by > rSq)
+                        continue;
+                    if (const Entry *hit = firstWithin(i, std::min(i + BLOCK, end), center, rSq)) {
+                        if (!best || before(*hit, *best))
+                            best = hit;
+                        break; // nothing after the hit beats it
+                    }
+                }
+            }
+            return best;
+        }
+        size_t size() const { return entries.size(); }
+
+    private:
+        struct Pending {int cell; Entry entry;};
+        struct Box {float x0, y0, x1, y1;};
+        static constexpr int BLOCK = 16;
+
+        const Entry *firstWithin(int i, int end, SDL_FPoint center, float rSq) const {
+            for (; i < end; ++i) {
+                const float dx = entries[i].p.x - center.x, dy = entries[i].p.y - center.y;
+                if (dx * dx + dy * dy <= rSq)
+                    return &entries[i];
+            }
+            return nullptr;
+        }
+
+        int col(float x) const {
+            return SDL_clamp(static_cast<int>(std::floor((x - bounds.x) / cellW)), 0, cols - 1);
+        }
+        int row(float y) const {
+            return SDL_clamp(static_cast<int>(std::floor((y - bounds.y) / cellH)), 0, rows - 1);
+        }
+
+        SDL_FRect bounds;
+        int cols, rows;
+        float cellW, cellH;
+        std::vector<int> start;     // first entry of each cell (+ end sentinel)
+        std::vector<int> fill;
+        std::vector<Entry> entries;
+        std::vector<int> boxStart;  // first box of each cell (+ end sentinel), after build(before)
+        std::vector<Box> boxes;
+        std::vector<Pending> pending;
+    };
+    using SpatialGrid = SpatialGridOf<bagel::ent_type>;
+
+    // -----------------------------------------------------------------------------
+    // Tile grid (resource): one bit per map cell and row, road from
+    // res/flash_elemnt_map.txt plus a tower-occupancy layer
+    // -----------------------------------------------------------------------------
+    // Towers cover a FOOTPRINT×FOOTPRINT block of cells, so a placement test is a
+    // couple of row-word ANDs.
+    template <class Ent>
+    class TileGridOf {
+    public:
+        static constexpr int COLS = Element::MAP_COLS, ROWS = Element::MAP_ROWS;
+        static constexpr int FOOTPRINT = 2;
+        static constexpr float TILE_W = sprite_map.w * Element::TEX_SCALE / COLS;
+        static constexpr float TILE_H = sprite_map.h * Element::TEX_SCALE / ROWS;
+        using Row = std::uint32_t;
+        static_assert(COLS <= 32, "one Row word per map row");
+
+        // 0/1 matrix, one bracketed row per map row, 1 = road
+        bool load(const char *path) {
+            std::FILE *file = std::fopen(path, "rb");
+            if (file == nullptr) return false;
+            std::fill(std::begin(road), std::end(road), Row{0});
+            int depth = 0, r = 0, c = 0, ch;
+            while ((ch = std::fgetc(file)) != EOF) {
+                if (ch == '[') {
+                    ++depth;
+                    c = 0;
+                } else if (ch == ']') {
+                    if (--depth == 0) break;
+                    if (c == COLS) ++r;
+                } else if (depth == 2 && (ch == '0' || ch == '1') && r < ROWS && c < COLS) {
+                    if (ch == '1') road[r] |= Row{1} << c;
+                    ++c;
+                }
+            }
+            std::fclose(file);
+            return r == ROWS;
+        }
+
+        bool isRoad(int c, int r) const { return road[r] >> c & 1; }
+
+        // top-left cell of the footprint centred nearest to a screen point
+        static SDL_Point footprintAt(SDL_FPoint p) {
+            return {static_cast<int>(std::floor((p.x - Element::MAP_TEX_PAD_X) / TILE_W - (FOOTPRINT - 1) * 0.5f)),
+                    static_cast<int>(std::floor((p.y - Element::MAP_TEX_PAD_Y) / TILE_H - (FOOTPRINT - 1) * 0.5f))};
+        }
+        static SDL_FPoint footprintCenter(SDL_Point cell) {
+            return {Element::MAP_TEX_PAD_X + (cell.x + FOOTPRINT * 0.5f) * TILE_W,
+                    Element::MAP_TEX_PAD_Y + (cell.y + FOOTPRINT * 0.5f) * TILE_H};
+        }
+
+        bool canPlace(SDL_Point cell) const {
+            if (cell.x < 0 || cell.y < 0 || cell.x + FOOTPRINT > COLS || cell.y + FOOTPRINT > ROWS)
+                return false;
+            const Row bits = footprintBits(cell);
+            for (int r = cell.y; r < cell.y + FOOTPRINT; ++r)
+                if ((road[r] | towers[r]) & bits) return false;
+            return true;
+        }
+        void place(SDL_Point cell, Ent tower) {
+            const Row bits = footprintBits(cell);
+            for (int r = cell.y; r < cell.y + FOOTPRINT; ++r) {
+                towers[r] |= bits;
+                for (int c = cell.x; c < cell.x + FOOTPRINT; ++c)
+                    owner[r * COLS + c] = tower;
+            }
+        }
+        bool hasTower(int c, int r) const { return towers[r] >> c & 1; }
+        Ent towerAt(int c, int r) const { return owner[r * COLS + c]; } // valid when hasTower
+
+    private:
+        static Row footprintBits(SDL_Point cell) {
+            return ((Row{1} << FOOTPRINT) - 1) << cell.x;
+        }
+
+        Row road[ROWS]{};
+        Row towers[ROWS]{};
+        Ent owner[ROWS * COLS]{};
+    };
+    using TileGrid = TileGridOf<bagel::ent_type>;
+
     /// Wave config (static data, not ECS components)
     struct Wave {
         int count; // how many to spawn
@@ -187,9 +469,47 @@ namespace element {
         SDL_FRect sprite; // source rect in your atlas
     };
 
-    static constexpr Wave WAVES[] = {
-        {10, 0.5f, 100.f, 10, 1, Element::SHEEP_TEX},
-        {20, 0.5f, 120.f, 20, 3, Element::RABID_TEX}
+    // creep sprite per wave (tables().waves[i] uses CREEP_TEX[i])
+    static constexpr SDL_FRect CREEP_TEX[] = {
+        Element::SHEEP_TEX,
+        Element::RABID_TEX,
+        FRECT(sprite_3),
+        FRECT(sprite_4),
+        FRECT(sprite_5),
+        FRECT(sprite_6),
+        FRECT(sprite_7),
+        FRECT(sprite_8),
+        FRECT(sprite_9),
+        FRECT(sprite_10),
+        FRECT(sprite_11),
+        FRECT(sprite_12),
+        FRECT(sprite_13),
+        FRECT(sprite_14),
+        FRECT(sprite_15),
+        FRECT(sprite_16),
+        FRECT(sprite_17),
+        FRECT(sprite_18),
+        FRECT(sprite_19),
+        FRECT(sprite_20),
+        FRECT(sprite_21),
+        FRECT(sprite_22),
+        FRECT(sprite_23),
+        FRECT(sprite_24),
+        FRECT(sprite_25),
+        FRECT(sprite_26),
+        FRECT(sprite_27),
+        FRECT(sprite_28),
+        FRECT(sprite_29),
+        FRECT(sprite_30),
+        FRECT(sprite_31),
+        FRECT(sprite_32),
+        FRECT(sprite_33),
+        FRECT(sprite_34),
+        FRECT(sprite_35),
+        FRECT(sprite_36),
+        FRECT(sprite_37),
+        FRECT(sprite_38),
+        FRECT(sprite_39)
     };
-    static constexpr int WAVE_COUNT = sizeof(WAVES) / sizeof(WAVES[0]);
+    static constexpr int CREEP_TEX_COUNT = sizeof(CREEP_TEX) / sizeof(CREEP_TEX[0]);
 }
@@ -0,0 +1,193 @@
+#include "Tables.h"
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#ifdef ELEMENT_GENERATED_TABLES
+    #include "res/tables.h"
+#endif
+
+namespace element {
+    namespace {
+        constexpr int MAX_FIELDS = 16;
+        constexpr int MAX_RECORD = 1024; // bytes per row, longer rows are truncated
+
+        // Streams `path` through a fixed chunk and calls onRow(fields, count) for every
+        // record. Handles quoted fields ("a, b" and ""); views are only valid inside
+        // the callback.
+        template <class F>
+        bool forEachCsvRow(const char *path, F &&onRow) {
+            std::FILE *file = std::fopen(path, "rb");
+            if (file == nullptr) {
+                std::cerr << "cannot open " << path << std::endl;
+                return false;
+            }
+
+            char chunk[4096];
+            char record[MAX_RECORD];
+            int ends[MAX_FIELDS];
+            std::string_view fields[MAX_FIELDS];
+            int len = 0, count = 0;
+            bool quoted = false, closed = false;
+
+            const auto endField = [&] {
+                if (count < MAX_FIELDS) ends[count++] = len;
+            };
+            const auto endRecord = [&] {
+                endField();
+                for (int i = 0, begin = 0; i < count; begin = ends[i++])
+                    fields[i] = {record + begin, static_cast<size_t>(ends[i] - begin)};
+                onRow(fields, count);
+                len = count = 0;
+            };
+
+            size_t n;
+            while ((n = std::fread(chunk, 1, sizeof chunk, file)) > 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    const char c = chunk[i];
+                    if (quoted) {
+                        if (c == '"') { quoted = false; closed = true; continue; }
+                    } else if (c == '"') {
+                        quoted = true;
+                        if (!closed) continue; // opening quote; otherwise "" is a literal quote
+                    } else if (c == ',') {
+                        endField();
+                        closed = false;
+                        continue;
+                    } else if (c == '\n') {
+                        endRecord();
+                        closed = false;
+                        continue;
+                    } else if (c == '\r') {
+                        continue;
+                    }
+                    closed = false;
+                    if (len < MAX_RECORD) record[len++] = c;
+                }
+            }
+            if (len > 0 || count > 0)
+                endRecord();
+            std::fclose(file);
+            return true;
+        }
+
+        std::string_view trim(std::string_view s) {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+            return s;
+        }
+
+        int toInt(std::string_view s) {
+            s = trim(s);
+            int v = 0;
+            std::from_chars(s.data(), s.data() + s.size(), v);
+            return v;
+        }
+
+        // "Attack Rate" column -> seconds between shots
+        float fireInterval(std::string_view rate) {
+            rate = trim(rate);
+            if (rate == "Very fast") return 0.5f;
+            if (rate == "Fast")      return 1.0f;
+            if (rate == "Slow")      return 2.0f;
+            if (rate == "Very slow") return 3.0f;
+            return 1.0f;
+        }
+
+        constexpr std::string_view TOWER_NAMES[TOWER_KINDS] = {
+            "Arrow", "Cannon", "Air", "Water", "Earth", "Fire", "Rocket"};
+    }
+
+    bool loadTables(const char *towersCsv, const char *wavesCsv, Tables &out) {
+        out = Tables{};
+        bool header = true;
+
+        // Tower Name, Element(s), Cost, Damage, Range, Attack Rate, ...   ("Arrow 1", blank separator rows)
+        const bool towers = forEachCsvRow(towersCsv, [&](const std::string_view *f, int n) {
+            if (std::exchange(header, false) || n < 6) return;
+            const std::string_view name = trim(f[0]);
+            const size_t space = name.rfind(' ');
+            if (space == std::string_view::npos) return;
+
+            const std::string_view kindName = name.substr(0, space);
+            const int tier = toInt(name.substr(space + 1));
+            for (int k = 0; k < TOWER_KINDS; ++k) {
+                if (kindName != TOWER_NAMES[k] || tier < 1 || tier > MAX_TOWER_TIER) continue;
+                out.towers[k][tier - 1] = {toInt(f[2]), toInt(f[3]),
+                                           static_cast<float>(toInt(f[4])), fireInterval(f[5])};
+                if (tier > out.tiers[k]) out.tiers[k] = tier;
+            }
+        });
+
+        // Lv, Name, HP, Type, Gold, Number Appearing, ...   (Type: -, FAST, AIR, IMMUNE, BOSS, FAST&IMMUNE)
+        header = true;
+        const bool waves = forEachCsvRow(wavesCsv, [&](const std::string_view *f, int n) {
+            if (std::exchange(header, false) || n < 6) return;
+            const int level = toInt(f[0]);
+            if (level < 1 || level > MAX_WAVES) return;
+
+            const std::string_view type = trim(f[3]);
+            unsigned flags = 0;
+            if (type.find("FAST") != std::string_view::npos)   flags |= WAVE_FAST;
+            if (type.find("AIR") != std::string_view::npos)    flags |= WAVE_AIR;
+            if (type.find("IMMUNE") != std::string_view::npos) flags |= WAVE_IMMUNE;
+            if (type.find("BOSS") != std::string_view::npos)   flags |= WAVE_BOSS;
+
+            out.waves[level - 1] = {toInt(f[2]), toInt(f[4]), toInt(f[5]), flags};
+            if (level > out.waveCount) out.waveCount = level;
+        });
+
+        return towers && waves;
+    }
+
+    bool writeTablesHeader(const Tables &t, const char *path) {
+        std::FILE *file = std::fopen(path, "w");
+        if (file == nullptr) {
+            std::cerr << "cannot write " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "/* Auto-generated from \"Towers and Waves - *.csv\" (--gen-tables) - DO NOT EDIT MANUALLY */\n");
+        std::fprintf(file, "#pragma once\n\n");
+        std::fprintf(file, "inline constexpr element::Tables GENERATED_TABLES = {\n");
+
+        std::fprintf(file, "    { // towers[kind][tier - 1]: cost, damage, range, fireInterval\n");
+        for (int k = 0; k < TOWER_KINDS; ++k) {
+            std::fprintf(file, "        { // %.*s\n", static_cast<int>(TOWER_NAMES[k].size()), TOWER_NAMES[k].data());
+            for (const TowerStats &s: t.towers[k])
+                std::fprintf(file, "            {%d, %d, %.6ff, %.6ff},\n", s.cost, s.damage, s.range, s.fireInterval);
+            std::fprintf(file, "        },\n");
+        }
+        std::fprintf(file, "    },\n    {");
+        for (int k = 0; k < TOWER_KINDS; ++k)
+            std::fprintf(file, "%s%d", k ? ", " : "", t.tiers[k]);
+        std::fprintf(file, "},\n");
+
+        std::fprintf(file, "    { // waves[level - 1]: hp, gold, count, flags\n");
+        for (int i = 0; i < t.waveCount; ++i) {
+            const WaveStats &w = t.waves[i];
+            std::fprintf(file, "        {%d, %d, %d, %uu},\n", w.hp, w.gold, w.count, w.flags);
+        }
+        std::fprintf(file, "    },\n    %d\n};\n", t.waveCount);
+
+        const bool ok = std::ferror(file) == 0;
+        std::fclose(file);
+        return ok;
+    }
+
+    const Tables &tables() {
+#ifdef ELEMENT_GENERATED_TABLES
+        return GENERATED_TABLES;
+#else
+        static const Tables loaded = [] {
+            Tables t{};
+            if (!loadTables(TOWERS_CSV, WAVES_CSV, t))
+                std::cerr << "tower/wave tables not loaded" << std::endl;
+            return t;
+        }();
+        return loaded;
+#endif
+    }
+}
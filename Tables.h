@@ -0,0 +1,50 @@
+#pragma once
+
+// Tower and wave tables from res/"Towers and Waves - *.csv".
+// Loaded once at startup, or compiled in from res/tables.h (ELEMENT_GENERATED_TABLES).
+
+// @formatter:off
+namespace element {
+    constexpr const char *TOWERS_CSV = "res/Towers and Waves - Towers.csv";
+    constexpr const char *WAVES_CSV  = "res/Towers and Waves - Waves.csv";
+
+    enum class TowerKind {Arrow, Cannon, Air, Water, Earth, Fire, Rocket, COUNT};
+    constexpr int TOWER_KINDS    = static_cast<int>(TowerKind::COUNT);
+    constexpr int MAX_TOWER_TIER = 4;
+    constexpr int MAX_WAVES      = 64;
+
+    struct TowerStats {
+        int cost;
+        int damage;
+        float range;        // map pixels (unscaled)
+        float fireInterval; // seconds between shots
+    };
+
+    enum WaveFlags : unsigned {WAVE_FAST = 1, WAVE_AIR = 2, WAVE_IMMUNE = 4, WAVE_BOSS = 8};
+
+    struct WaveStats {
+        int hp;
+        int gold;           // bounty per creep
+        int count;          // creeps in the wave
+        unsigned flags;     // WaveFlags
+    };
+
+    struct Tables {
+        TowerStats towers[TOWER_KINDS][MAX_TOWER_TIER]; // [kind][tier - 1]
+        int tiers[TOWER_KINDS];
+        WaveStats waves[MAX_WAVES];                     // [level - 1]
+        int waveCount;
+
+        constexpr const TowerStats &tower(TowerKind k, int tier) const {
+            return towers[static_cast<int>(k)][tier - 1];
+        }
+    };
+
+    // streaming parse through a fixed buffer, no heap allocation
+    bool loadTables(const char *towersCsv, const char *wavesCsv, Tables &out);
+    // writes `t` as a constexpr initializer, in the style of res/atlas.h
+    bool writeTablesHeader(const Tables &t, const char *path);
+    // the generated tables when compiled in, otherwise the CSVs parsed on first use
+    const Tables &tables();
+}
+// @formatter:on
@@ -1,14 +1,43 @@
 // Copyright (C) 2025 Moshe Sulamy
 // bagel.h file
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <type_traits>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#define BAGEL_MMAP
+#endif
 
 namespace bagel
 {
+	// where DynamicBag memory comes from: malloc/realloc, or one slot per bag in a
+	// reserved address range whose pages are committed as the bag grows, so it never moves
+	enum class Memory { Heap, Arena };
+#ifdef BAGEL_MMAP
+	constexpr bool ArenaAvailable = true;
+#else
+	constexpr bool ArenaAvailable = false;	// no way to reserve address space: Memory::Heap only
+#endif
+
 	struct Bagel
 	{
 		bool	DynamicResize = false;
@@ -16,23 +45,44 @@ namespace bagel
 		int		InitialEntities = 10;
 		int		InitialPackedSize = 5;
 		int		MaxComponents = 10;
+		Memory	Allocation = Memory::Heap;
+		size_t	ArenaBytes = size_t{64} << 30;		// address space for all the slots
+		size_t	ArenaSlotBytes = size_t{256} << 20;	// per bag; a bag outgrowing it moves to the heap
 	};
 
 	template <class T> struct Storage;
 	template <class T> class PackedStorage;
 	template <class T> class SparseStorage;
 	template <class T> class TaggedStorage;
+	template <class T> class ArchetypeStorage;
+	template <class T> class SoAPackedStorage;
+	template <class T> struct Fields;
+
+	template <class ...Ts>
+	struct TypeList
+	{
+		static constexpr int size = sizeof...(Ts);
+		template <class T> using append = TypeList<Ts...,T>;
+	};
+	template <int N> struct Rank : Rank<N-1> {};
+	template <> struct Rank<0> {};
+	TypeList<> registered(Rank<0>);
 
 #if __has_include("bagel_cfg.h")
-	#define BAGEL_STORAGE(C,T) template <> struct Storage<C> { using type = T<C>; };
+	#define BAGEL_REGISTERED decltype(registered(Rank<Params.MaxComponents>{}))
+	#define BAGEL_STORAGE(C,T) template <> struct Storage<C> { using type = T<C>; static constexpr const char* name = #C; }; \
+		BAGEL_REGISTERED::append<C> registered(Rank<BAGEL_REGISTERED::size+1>);
 	#include "bagel_cfg.h"
 	#undef BAGEL_STORAGE
+	#undef BAGEL_REGISTERED
 #else
 	constexpr Bagel Params{};
 #endif
+	using Registered = decltype(registered(Rank<Params.MaxComponents>{}));
 
 	using id_type = int;
-	struct ent_type { id_type id; };
+	using gen_type = int;
+	struct ent_type { id_type id; gen_type gen = 0; };
 	using size_type = int;
 	using index_type = int;
 	using mask_type =
@@ -49,70 +99,365 @@ namespace bagel
 		void operator=(const NoCopy&) = delete;
 	};
 
-	template <class T, int N>
+	struct HeapMemory final : NoInstance
+	{
+		static void* allocate(size_t bytes) { return malloc(bytes); }
+		static void* resize(void* p, size_t, size_t bytes) { return realloc(p, bytes); }
+		static void release(void* p, size_t) { free(p); }
+	};
+#ifdef BAGEL_MMAP
+	// the range is reserved on first use and never unmapped, so bags destroyed at exit
+	// can still hand their slots back; released slots are reused through a free list
+	class ArenaMemory final : NoInstance
+	{
+	public:
+		static void* allocate(size_t bytes) {
+			char* slot = bytes <= Params.ArenaSlotBytes ? take() : nullptr;
+			if (!slot || !commit(slot, 0, bytes))
+				return malloc(bytes); // an uncommitted slot is only address space, left unused
+			return slot;
+		}
+		static void* resize(void* p, size_t old, size_t bytes) {
+			if (!owns(p))
+				return realloc(p, bytes);
+			if (bytes <= Params.ArenaSlotBytes && commit(static_cast<char*>(p), old, bytes))
+				return p;
+			void* q = malloc(bytes);
+			memcpy(q, p, old);
+			release(p, old);
+			return q;
+		}
+		static void release(void* p, size_t bytes) {
+			if (!owns(p)) {
+				free(p);
+				return;
+			}
+			commit(static_cast<char*>(p), bytes, sizeof(void*));
+			std::lock_guard<std::mutex> lock(_mutex);
+			*static_cast<void**>(p) = _free;
+			_free = p;
+		}
+		static bool owns(const void* p) {
+			return _base && p >= _base && p < _base + Params.ArenaBytes;
+		}
+	private:
+		static constexpr size_t HugePage = size_t{2} << 20;
+
+		static char* take() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_free) {
+				char* slot = static_cast<char*>(_free);
+				_free = *static_cast<void**>(_free);
+				return slot;
+			}
+			if (!_base && _next == 0)
+				reserve();
+			if (!_base || _next + Params.ArenaSlotBytes > Params.ArenaBytes)
+				return nullptr;
+			char* slot = _base + _next;
+			_next += Params.ArenaSlotBytes;
+			return slot;
+		}
+		static void reserve() {
+			_page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#ifdef MAP_NORESERVE
+			constexpr int Flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+			constexpr int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+			void* p = mmap(nullptr, Params.ArenaBytes + HugePage, PROT_NONE, Flags, -1, 0);
+			if (p == MAP_FAILED) {
+				_next = Params.ArenaBytes; // heap from now on
+				return;
+			}
+			const uintptr_t a = (reinterpret_cast<uintptr_t>(p) + HugePage - 1) & ~(HugePage - 1);
+			_base = reinterpret_cast<char*>(a);
+#ifdef MADV_HUGEPAGE
+			madvise(_base, Params.ArenaBytes, MADV_HUGEPAGE);
+#endif
+		}
+		// pages for [0, to) of a slot that had [0, from) committed; false if growing failed,
+		// and the caller falls back to the heap
+		static bool commit(char* slot, size_t from, size_t to) {
+			from = (from + _page - 1) & ~(_page - 1);
+			to = (to + _page - 1) & ~(_page - 1);
+			if (to > from)
+				return mprotect(slot + from, to - from, PROT_READ | PROT_WRITE) == 0;
+			if (to < from) {
+				madvise(slot + to, from - to, MADV_DONTNEED);
+				mprotect(slot + to, from - to, PROT_NONE); // pages left readable are harmless
+			}
+			return true;
+		}
+
+		static inline char*			_base = nullptr;
+		static inline size_t		_next = 0;
+		static inline size_t		_page = 0;
+		static inline void*			_free = nullptr;
+		static inline std::mutex	_mutex;
+	};
+#else
+	using ArenaMemory = HeapMemory;
+#endif
+	static_assert(Params.Allocation != Memory::Arena || ArenaAvailable,
+		"Memory::Arena needs mmap, configure Memory::Heap on this platform");
+	using BagMemory = std::conditional_t<Params.Allocation == Memory::Arena, ArenaMemory, HeapMemory>;
+
+	template <class T, int N, class M = BagMemory>
 	class DynamicBag : NoCopy
 	{
 	public:
 		void push(const T& t) {
-			if (_size == _capacity) {
-				_capacity *= 2;
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
-			}
+			if (_size == _capacity)
+				reallocate(_capacity*2);
 			_arr[_size] = t;
-			++_size;
+			if (++_size > _peak)
+				_peak = _size;
 		}
 		void ensure(size_type s) {
-			if (_capacity < s) {
-				_capacity = std::max(s, _capacity*2);
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
-			}
+			if (_capacity < s)
+				reallocate(std::max(s, _capacity*2));
+		}
+		void resize(size_type s) {
+			ensure(s);
+			_size = s;
+			_peak = std::max(_peak, s);
+		}
+		// capacity back down to the contents, `keep` slots, or N, whichever is largest
+		void shrink(size_type keep = 0) {
+			const size_type c = std::max({_size, keep, N});
+			if (c < _capacity)
+				reallocate(c);
 		}
 		T pop() { return _arr[--_size]; }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
+		T* data() { return _arr; }
+		const T* data() const { return _arr; }
 		void clear() { _size = 0; }
 
 		size_type size() const { return _size; }
 		size_type capacity() const { return _capacity; }
+		size_type peak() const { return _peak; }
+		size_t bytes() const { return sizeof(T) * _capacity; }
 
-		~DynamicBag() { free(_arr); }
+		~DynamicBag() { M::release(_arr, bytes()); }
 	private:
-		T*			_arr = static_cast<T*>(malloc(sizeof(T) * N));
+		void reallocate(size_type c) {
+			_arr = static_cast<T*>(M::resize(_arr, bytes(), sizeof(T)*c));
+			_capacity = c;
+		}
+
+		T*			_arr = static_cast<T*>(M::allocate(sizeof(T) * N));
 		size_type	_size = 0;
 		size_type	_capacity = N;
+		size_type	_peak = 0;	// high-water mark of _size
 	};
 	template <class T, int N>
 	class StaticBag
 	{
 	public:
-		void push(const T& t) { _arr[_size++] = t; }
+		void push(const T& t) {
+			_arr[_size++] = t;
+			_peak = std::max(_peak, _size);
+		}
+		void resize(size_type s) {
+			_size = s;
+			_peak = std::max(_peak, s);
+		}
 		T pop() { return _arr[--_size]; }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
+		T* data() { return _arr; }
+		const T* data() const { return _arr; }
 		void clear() { _size = 0; }
 
 		size_type size() const { return _size; }
 		static constexpr size_type capacity() { return N; }
+		size_type peak() const { return _peak; }
+		static constexpr size_t bytes() { return sizeof(T) * N; }
 		static void ensure(size_type) {}
+		static void shrink(size_type = 0) {}
 	private:
 		T			_arr[N];
 		size_type	_size = 0;
+		size_type	_peak = 0;
 	};
 	template <class T, int N>
 	using Bag = std::conditional_t<Params.DynamicResize, DynamicBag<T, N>, StaticBag<T,N>>;
 
+	class Snapshot : NoCopy
+	{
+	public:
+		template <class T>
+		void put(const T* src, size_type n) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const size_type at = _bytes.size();
+			_bytes.resize(at + n*static_cast<size_type>(sizeof(T)));
+			memcpy(_bytes.data() + at, src, n*sizeof(T));
+		}
+		template <class T>
+		void put(const T& t) { put(&t, 1); }
+		template <class B>
+		void bag(const B& b) {
+			put(b.size());
+			put(b.data(), b.size());
+		}
+		template <class B>
+		void sparse(const B& b, size_type entities) {
+			const size_type n = std::min(entities, b.capacity());
+			put(n);
+			put(b.data(), n);
+		}
+		template <class T>
+		void patch(size_type at, const T& t) { memcpy(_bytes.data() + at, &t, sizeof(T)); }
+
+		void clear() { _bytes.clear(); }
+		const unsigned char* data() const { return _bytes.data(); }
+		size_type size() const { return _bytes.size(); }
+
+		bool save(const char* path) const {
+			FILE* f = fopen(path, "wb");
+			if (!f)
+				return false;
+			const bool ok = fwrite(data(), 1, size(), f) == static_cast<size_t>(size());
+			return fclose(f) == 0 && ok;
+		}
+	private:
+		DynamicBag<unsigned char, 4096, HeapMemory> _bytes;	// short-lived and many: not worth an arena slot each
+	};
+	class SnapshotReader
+	{
+	public:
+		SnapshotReader(const void* data, size_t bytes)
+			: _at(static_cast<const unsigned char*>(data)), _end(_at + bytes) {}
+
+		template <class T>
+		bool get(T* dst, size_type n) {
+			if (!_ok || n < 0 || static_cast<size_t>(_end - _at) < n*sizeof(T))
+				return _ok = false;
+			memcpy(dst, _at, n*sizeof(T));
+			_at += n*sizeof(T);
+			return true;
+		}
+		template <class T>
+		bool get(T& t) { return get(&t, 1); }
+		template <class B>
+		bool bag(B& b) {
+			size_type n = -1;
+			if (!get(n) || n < 0 || (n > b.capacity() && !Params.DynamicResize))
+				return _ok = false;
+			b.resize(n);
+			return get(b.data(), n);
+		}
+		template <class B>
+		bool sparse(B& b) {
+			size_type n = -1;
+			if (!get(n) || n < 0 || (n > b.capacity() && !Params.DynamicResize))
+				return _ok = false;
+			b.ensure(n);
+			return get(b.data(), n);
+		}
+		bool ok() const { return _ok; }
+		size_t remaining() const { return static_cast<size_t>(_end - _at); }
+	private:
+		const unsigned char*	_at;
+		const unsigned char*	_end;
+		bool					_ok = true;
+	};
+	class MappedFile : NoCopy
+	{
+	public:
+		explicit MappedFile(const char* path) {
+#ifdef BAGEL_MMAP
+			const int fd = open(path, O_RDONLY);
+			struct stat st;
+			if (fd < 0)
+				return;
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+				void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p != MAP_FAILED) {
+					_data = p;
+					_size = st.st_size;
+				}
+			}
+			close(fd);
+#else
+			FILE* f = fopen(path, "rb");
+			if (!f)
+				return;
+			if (fseek(f, 0, SEEK_END) == 0 && ftell(f) > 0) {
+				_size = ftell(f);
+				_data = malloc(_size);
+				rewind(f);
+				if (fread(_data, 1, _size, f) != _size) {
+					free(_data);
+					_data = nullptr;
+					_size = 0;
+				}
+			}
+			fclose(f);
+#endif
+		}
+		~MappedFile() {
+#ifdef BAGEL_MMAP
+			if (_data)
+				munmap(_data, _size);
+#else
+			free(_data);
+#endif
+		}
+		const void* data() const { return _data; }
+		size_t size() const { return _size; }
+	private:
+		void*	_data = nullptr;
+		size_t	_size = 0;
+	};
+
+	// what one storage holds: components now, the most it ever held, room, and bytes
+	// allocated for it (sparse arrays count one slot per entity id)
+	struct Usage
+	{
+		const char*	name;
+		size_type	size;
+		size_type	peak;
+		size_type	capacity;
+		size_t		bytes;
+	};
+	// `count` items `stride` bytes apart, as a storage lays them out
+	struct RawSpan
+	{
+		void*		data;
+		size_type	count;
+		size_t		stride;
+	};
+
 	template <class T>
 	class SparseStorage final : NoInstance
 	{
 	public:
 		static void add(ent_type e, const T& t) {
-			_bag.ensure(e.id);
+			_bag.ensure(e.id + 1);
 			_bag[e.id] = t;
 		}
+		// add(es[i], at(i)) for i in [0, n)
+		template <class F>
+		static void append(const ent_type* es, size_type n, F&& at) {
+			for (index_type i = 0; i < n; ++i)
+				add(es[i], at(i));
+		}
 		static void del(ent_type) {}
 		static T& get(ent_type e) { return _bag[e.id]; }
+		static void reserve(size_type entities, size_type) { _bag.ensure(entities); }
+		static void shrink(size_type entities) { _bag.shrink(entities); }
+		static Usage usage() {
+			return {nullptr, _bag.capacity(), _bag.capacity(), _bag.capacity(), _bag.bytes()};
+		}
+		static constexpr size_type Spans = 1; // indexed by entity id
+		static RawSpan span(index_type) { return {_bag.data(), _bag.capacity(), sizeof(T)}; }
+
+		static void save(Snapshot& s, size_type entities) { s.sparse(_bag, entities); }
+		static bool load(SnapshotReader& r) { return r.sparse(_bag); }
 	private:
 		static inline Bag<T,Params.InitialEntities> _bag;
 	};
@@ -121,19 +466,54 @@ namespace bagel
 	{
 	public:
 		static void add(ent_type e, const T& t) {
-			_entToComp.ensure(e.id);
+			_entToComp.ensure(e.id + 1);
 			_entToComp[e.id] = _comps.size();
 			_comps.push(t);
 			_compToEnt.push(e);
 		}
+		// add(es[i], at(i)) for i in [0, n): the dense arrays grow once and fill in order
+		template <class F>
+		static void append(const ent_type* es, size_type n, F&& at) {
+			const size_type first = _comps.size();
+			_comps.resize(first + n);
+			_compToEnt.resize(first + n);
+			for (index_type i = 0; i < n; ++i) {
+				_entToComp.ensure(es[i].id + 1);
+				_entToComp[es[i].id] = first + i;
+				_comps[first + i] = at(i);
+				_compToEnt[first + i] = es[i];
+			}
+		}
 		static void del(ent_type e) {
-			index_type ent_comp_idx = _entToComp[e.id];
+			delAt(_entToComp[e.id]);
+		}
+		// room for ids below `entities` and `more` components past the current ones
+		static void reserve(size_type entities, size_type more) {
+			_entToComp.ensure(entities);
+			_comps.ensure(_comps.size() + more);
+			_compToEnt.ensure(_compToEnt.size() + more);
+		}
+		static void shrink(size_type entities) {
+			_entToComp.shrink(entities);
+			_comps.shrink();
+			_compToEnt.shrink();
+		}
+		static Usage usage() {
+			return {nullptr, _comps.size(), _comps.peak(), _comps.capacity(),
+				_comps.bytes() + _entToComp.bytes() + _compToEnt.bytes()};
+		}
+		static constexpr size_type Spans = 1;
+		static RawSpan span(index_type) { return {_comps.data(), _comps.size(), sizeof(T)}; }
+		static void delAt(index_type ent_comp_idx) {
 			ent_type last_ent = _compToEnt.pop();
 
 			_comps[ent_comp_idx] = _comps.pop();
 			_compToEnt[ent_comp_idx] = last_ent;
 			_entToComp[last_ent.id] = ent_comp_idx;
 		}
+		static index_type index(ent_type e) {
+			return _entToComp[e.id];
+		}
 		static T& get(ent_type e) {
 			return _comps[_entToComp[e.id]];
 		}
@@ -144,18 +524,182 @@ namespace bagel
 		static ent_type entity(index_type idx) {
 			return _compToEnt[idx];
 		}
+
+		static void save(Snapshot& s, size_type entities) {
+			s.bag(_comps);
+			s.sparse(_entToComp, entities);
+			s.bag(_compToEnt);
+		}
+		static bool load(SnapshotReader& r) {
+			return r.bag(_comps) && r.sparse(_entToComp) && r.bag(_compToEnt);
+		}
 	private:
 		static inline Bag<T,Params.InitialPackedSize>			_comps;
 		static inline Bag<index_type,Params.InitialEntities>	_entToComp;
 		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
 	};
+	template <class F>
+	struct Span
+	{
+		F*			data;
+		size_type	size;
+
+		F* begin() const { return data; }
+		F* end() const { return data + size; }
+		F& operator[](index_type i) const { return data[i]; }
+	};
+
+	template <class M> struct MemberOf;
+	template <class C, class F> struct MemberOf<F C::*> { using type = F; };
+
+	template <class T>
+	class SoAPackedStorage final : NoInstance
+	{
+		static constexpr auto& Members = Fields<T>::members;
+		static constexpr size_type Count = std::tuple_size_v<std::decay_t<decltype(Members)>>;
+		template <size_type I>
+		using field_type = typename MemberOf<std::tuple_element_t<I, std::decay_t<decltype(Members)>>>::type;
+		template <class Seq> struct Columns;
+		template <size_type ...Is>
+		struct Columns<std::integer_sequence<size_type, Is...>> {
+			using type = std::tuple<Bag<field_type<Is>,Params.InitialPackedSize>...>;
+		};
+		using Seq = std::make_integer_sequence<size_type, Count>;
+	public:
+		using ref = typename Fields<T>::ref;
+
+		static void add(ent_type e, const T& t) {
+			_entToComp.ensure(e.id + 1);
+			_entToComp[e.id] = _compToEnt.size();
+			push(t, Seq{});
+			_compToEnt.push(e);
+		}
+		// add(es[i], at(i)) for i in [0, n), one pass per column
+		template <class F>
+		static void append(const ent_type* es, size_type n, F&& at) {
+			const size_type first = _compToEnt.size();
+			_compToEnt.resize(first + n);
+			for (index_type i = 0; i < n; ++i) {
+				_entToComp.ensure(es[i].id + 1);
+				_entToComp[es[i].id] = first + i;
+				_compToEnt[first + i] = es[i];
+			}
+			scatter(first, n, at, Seq{});
+		}
+		static void del(ent_type e) {
+			delAt(_entToComp[e.id]);
+		}
+		static void reserve(size_type entities, size_type more) {
+			_entToComp.ensure(entities);
+			std::apply([&](auto&... cols) { (cols.ensure(cols.size() + more), ...); }, _columns);
+			_compToEnt.ensure(_compToEnt.size() + more);
+		}
+		static void shrink(size_type entities) {
+			_entToComp.shrink(entities);
+			std::apply([](auto&... cols) { (cols.shrink(), ...); }, _columns);
+			_compToEnt.shrink();
+		}
+		static Usage usage() {
+			const size_t columns = std::apply([](const auto&... cols) { return (cols.bytes() + ...); }, _columns);
+			return {nullptr, _compToEnt.size(), _compToEnt.peak(), _compToEnt.capacity(),
+				columns + _entToComp.bytes() + _compToEnt.bytes()};
+		}
+		static constexpr size_type Spans = Count; // one per field
+		static RawSpan span(index_type column) {
+			RawSpan r{};
+			index_type i = 0;
+			std::apply([&](auto&... cols) {
+				((i++ == column ? void(r = {cols.data(), cols.size(), sizeof(cols[0])}) : void()), ...);
+			}, _columns);
+			return r;
+		}
+		static void delAt(index_type ent_comp_idx) {
+			ent_type last_ent = _compToEnt.pop();
+
+			fill(ent_comp_idx, Seq{});
+			_compToEnt[ent_comp_idx] = last_ent;
+			_entToComp[last_ent.id] = ent_comp_idx;
+		}
+		static index_type index(ent_type e) {
+			return _entToComp[e.id];
+		}
+		static ref get(ent_type e) {
+			return get(_entToComp[e.id]);
+		}
+		static int size() { return _compToEnt.size(); }
+		static ref get(index_type idx) {
+			return bind(idx, Seq{});
+		}
+		static ent_type entity(index_type idx) {
+			return _compToEnt[idx];
+		}
+		static T load(index_type idx) {
+			T t{};
+			gather(t, idx, Seq{});
+			return t;
+		}
+
+		template <size_type I>
+		static Span<field_type<I>> column() {
+			return {&std::get<I>(_columns)[0], size()};
+		}
+
+		static void save(Snapshot& s, size_type entities) {
+			std::apply([&](auto&... cols) { (s.bag(cols), ...); }, _columns);
+			s.sparse(_entToComp, entities);
+			s.bag(_compToEnt);
+		}
+		static bool load(SnapshotReader& r) {
+			return std::apply([&](auto&... cols) { return (r.bag(cols) && ...); }, _columns)
+				&& r.sparse(_entToComp) && r.bag(_compToEnt);
+		}
+	private:
+		template <size_type ...Is>
+		static void push(const T& t, std::integer_sequence<size_type, Is...>) {
+			(std::get<Is>(_columns).push(t.*std::get<Is>(Members)), ...);
+		}
+		template <class F, size_type ...Is>
+		static void scatter(size_type first, size_type n, F& at, std::integer_sequence<size_type, Is...>) {
+			([&](auto& col, auto member) {
+				col.resize(first + n);
+				for (index_type i = 0; i < n; ++i)
+					col[first + i] = at(i).*member;
+			}(std::get<Is>(_columns), std::get<Is>(Members)), ...);
+		}
+		template <size_type ...Is>
+		static void fill(index_type idx, std::integer_sequence<size_type, Is...>) {
+			((std::get<Is>(_columns)[idx] = std::get<Is>(_columns).pop()), ...);
+		}
+		template <size_type ...Is>
+		static ref bind(index_type idx, std::integer_sequence<size_type, Is...>) {
+			return ref{std::get<Is>(_columns)[idx]...};
+		}
+		template <size_type ...Is>
+		static void gather(T& t, index_type idx, std::integer_sequence<size_type, Is...>) {
+			((t.*std::get<Is>(Members) = std::get<Is>(_columns)[idx]), ...);
+		}
+
+		static inline typename Columns<Seq>::type				_columns;
+		static inline Bag<index_type,Params.InitialEntities>	_entToComp;
+		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
+	};
 	template <class T>
 	class TaggedStorage final : NoInstance
 	{
 	public:
 		static void add(ent_type, const T&) {}
+		template <class F>
+		static void append(const ent_type*, size_type, F&&) {}
 		static void del(ent_type) {}
 		static T& get(ent_type) = delete;
+		static void reserve(size_type, size_type) {}
+		static void shrink(size_type) {}
+		static Usage usage() { return {}; }
+		static constexpr size_type Spans = 0;
+		static RawSpan span(index_type) { return {}; }
+
+		static void save(Snapshot&, size_type) {}
+		static bool load(SnapshotReader&) { return true; }
 	};
 
 	template <class T>
@@ -167,7 +711,7 @@ namespace bagel
 	{
 	public:
 		using bit_type = mask_type;
-		static constexpr bit_type bit(index_type idx) { return 1<<idx; }
+		static constexpr bit_type bit(index_type idx) { return mask_type{1}<<idx; }
 
 		void set(const bit_type b) { _mask |= b; }
 
@@ -176,6 +720,8 @@ namespace bagel
 
 		bool test(const bit_type b) const { return _mask & b; }
 		bool test(const SingleMask m) const { return (_mask & m._mask) == m._mask; }
+		bool intersects(const SingleMask m) const { return _mask & m._mask; }
+		bool operator==(const SingleMask m) const { return _mask == m._mask; }
 	private:
 		mask_type	_mask{0};
 	};
@@ -187,7 +733,7 @@ namespace bagel
 			const mask_type		mask;
 		};
 		static constexpr bit_type bit(index_type idx) {
-			return {idx/BitsetWidth, static_cast<mask_type>(1<<(idx%BitsetWidth))};
+			return {idx/BitsetWidth, static_cast<mask_type>(mask_type{1}<<(idx%BitsetWidth))};
 		}
 
 		void set(const bit_type& b) { _masks[b.index] |= b.mask; }
@@ -202,13 +748,35 @@ namespace bagel
 					return false;
 			return true;
 		}
+		bool intersects(const MultiMask& m) const {
+			for (index_type i = 0; i < Size; ++i)
+				if (_masks[i] & m._masks[i])
+					return true;
+			return false;
+		}
+		bool operator==(const MultiMask& m) const {
+			return memcmp(_masks, m._masks, sizeof(_masks)) == 0;
+		}
 	private:
 		static constexpr size_type	Size = (Params.MaxComponents-1)/BitsetWidth + 1;
 		mask_type					_masks[Size] ={};
 	};
 	using Mask = std::conditional_t<Params.MaxComponents<=BitsetWidth, SingleMask, MultiMask>;
 
-	static inline index_type compCounter = -1;
+	template <class T>
+	constexpr bool IsPacked = std::is_same_v<typename Storage<T>::type, PackedStorage<T>>
+		|| std::is_same_v<typename Storage<T>::type, SoAPackedStorage<T>>;
+	template <class T>
+	constexpr bool IsArchetype = std::is_same_v<typename Storage<T>::type, ArchetypeStorage<T>>;
+	template <class T>
+	constexpr bool IsTag = std::is_same_v<typename Storage<T>::type, TaggedStorage<T>>;
+
+	template <class T>
+	using ref_type = decltype(Storage<T>::type::get(std::declval<ent_type>()));
+
+	template <class ...Ts> class View;
+
+	inline index_type compCounter = -1; // one counter for the program, not one per translation unit
 	template <class>
 	struct Component final : NoInstance
 	{
@@ -216,32 +784,420 @@ namespace bagel
 		static inline const Mask::bit_type	Bit = Mask::bit(Index);
 	};
 
+	class Archetypes final : NoInstance
+	{
+	public:
+		static constexpr size_type ChunkBytes = 16*1024;
+		struct Chunk
+		{
+			Chunk*			next;
+			Chunk*			prev;
+			index_type		archetype;
+			size_type		size;
+			alignas(16) unsigned char data[ChunkBytes - 32];
+		};
+		struct Archetype
+		{
+			Mask		mask;
+			index_type	offset[Params.MaxComponents];
+			size_type	rows;
+			Chunk*		head;
+			Chunk*		tail;
+		};
+
+		static void declare(index_type comp, size_type bytes) { _bytes[comp] = bytes; }
+
+		static Mask signature(ent_type e) {
+			const Chunk* c = where(e).chunk;
+			return c ? _archetypes[c->archetype].mask : Mask{};
+		}
+		static unsigned char* column(ent_type e, index_type comp) {
+			const Location& l = _where[e.id];
+			return column(l.chunk, comp, l.row);
+		}
+		static unsigned char* column(Chunk* c, index_type comp, index_type row) {
+			return c->data + _archetypes[c->archetype].offset[comp] + row*_bytes[comp];
+		}
+		static ent_type entity(const Chunk* c, index_type row) {
+			return reinterpret_cast<const ent_type*>(c->data)[row];
+		}
+
+		static size_type count() { return _archetypes.size(); }
+		static const Archetype& archetype(index_type a) { return _archetypes[a]; }
+
+		static void move(ent_type e, const Mask& to) {
+			const Location from = where(e);
+			if (from.chunk && _archetypes[from.chunk->archetype].mask == to)
+				return;
+			if (Mask{}.test(to)) {
+				erase(e);
+				return;
+			}
+			const index_type a = find(to);
+			const Location dst = append(a, e);
+			if (from.chunk) {
+				const Archetype& src = _archetypes[from.chunk->archetype];
+				for (index_type c = 0; c < Params.MaxComponents; ++c)
+					if (_archetypes[a].offset[c] >= 0 && src.offset[c] >= 0)
+						memcpy(column(dst.chunk, c, dst.row), column(from.chunk, c, from.row), _bytes[c]);
+				removeAt(from);
+			}
+			_where[e.id] = dst;
+		}
+		static void reserve(size_type entities) { _where.ensure(entities); }
+		static void erase(ent_type e) {
+			if (e.id >= _where.size() || !_where[e.id].chunk)
+				return;
+			removeAt(_where[e.id]);
+			_where[e.id] = {};
+		}
+
+		static void save(Snapshot& s) {
+			s.put(_bytes, Params.MaxComponents);
+			s.put(_archetypes.size());
+			for (index_type a = 0; a < _archetypes.size(); ++a) {
+				const Archetype& arch = _archetypes[a];
+				size_type used = 0;
+				for (const Chunk* c = arch.head; c && c->size > 0; c = c->next)
+					++used;
+				s.put(arch.mask);
+				s.put(arch.offset, Params.MaxComponents);
+				s.put(arch.rows);
+				s.put(used);
+				for (const Chunk* c = arch.head; c && c->size > 0; c = c->next) {
+					s.put(c->size);
+					s.put(c->data, sizeof(c->data));
+				}
+			}
+		}
+		static bool load(SnapshotReader& r) {
+			// every archetype record holds at least its mask, offsets, rows and chunk count
+			constexpr size_t Record = sizeof(Mask) + sizeof(index_type)*Params.MaxComponents + 2*sizeof(size_type);
+			size_type count = -1;
+			if (!r.get(_bytes, Params.MaxComponents) || !r.get(count) || count < 0
+					|| static_cast<size_t>(count) > r.remaining() / Record
+					|| (count > _archetypes.capacity() && !Params.DynamicResize))
+				return false;
+			while (_archetypes.size() < count)
+				_archetypes.push(Archetype{Mask{}, {}, 0, nullptr, nullptr});
+
+			// chunks are reused in list order; archetypes the snapshot lacks end up empty
+			_where.clear();
+			for (index_type a = 0; a < _archetypes.size(); ++a) {
+				Archetype& arch = _archetypes[a];
+				size_type used = 0;
+				if (a < count && !(r.get(arch.mask) && r.get(arch.offset, Params.MaxComponents)
+						&& r.get(arch.rows) && r.get(used)))
+					return false;
+				arch.tail = arch.head;
+				Chunk* prev = nullptr;
+				Chunk* c = arch.head;
+				for (index_type i = 0; i < used; ++i, prev = c, c = c->next) {
+					if (!c) {
+						c = static_cast<Chunk*>(malloc(sizeof(Chunk)));
+						*c = {nullptr, prev, a, 0, {}};
+						if (prev) prev->next = c;
+						else arch.head = c;
+					}
+					if (!r.get(c->size) || !r.get(c->data, sizeof(c->data)))
+						return false;
+					for (index_type row = 0; row < c->size; ++row) {
+						where(entity(c, row));
+						_where[entity(c, row).id] = {c, row};
+					}
+					arch.tail = c;
+				}
+				for (; c; c = c->next)
+					c->size = 0;
+			}
+			return true;
+		}
+	private:
+		struct Location
+		{
+			Chunk*		chunk = nullptr;
+			index_type	row = 0;
+		};
+
+		static const Location& where(ent_type e) {
+			while (_where.size() <= e.id)
+				_where.push(Location{});
+			return _where[e.id];
+		}
+		static index_type find(const Mask& m) {
+			for (index_type a = 0; a < _archetypes.size(); ++a)
+				if (_archetypes[a].mask == m)
+					return a;
+
+			Archetype arch{m, {}, 0, nullptr, nullptr};
+			size_type rowBytes = sizeof(ent_type), cols = 0;
+			for (index_type c = 0; c < Params.MaxComponents; ++c) {
+				arch.offset[c] = -1;
+				if (m.test(Mask::bit(c))) {
+					rowBytes += _bytes[c];
+					++cols;
+				}
+			}
+			arch.rows = (sizeof(Chunk::data) - 16*cols) / rowBytes;
+
+			size_type offset = sizeof(ent_type)*arch.rows;
+			for (index_type c = 0; c < Params.MaxComponents; ++c) {
+				if (!m.test(Mask::bit(c)))
+					continue;
+				offset = (offset + 15) & ~15;
+				arch.offset[c] = offset;
+				offset += _bytes[c]*arch.rows;
+			}
+			if (arch.rows <= 0 || offset > static_cast<size_type>(sizeof(Chunk::data)))
+				std::abort(); // this combination of components can't fit one row in a chunk
+			_archetypes.push(arch);
+			return _archetypes.size() - 1;
+		}
+		static Location append(index_type a, ent_type e) {
+			Archetype& arch = _archetypes[a];
+			Chunk* t = arch.tail;
+			if (!t || t->size == arch.rows) {
+				if (t && t->next) {
+					t = t->next;
+				} else {
+					Chunk* c = static_cast<Chunk*>(malloc(sizeof(Chunk)));
+					*c = {nullptr, t, a, 0, {}};
+					if (t) t->next = c;
+					else arch.head = c;
+					t = c;
+				}
+				arch.tail = t;
+			}
+			const index_type row = t->size++;
+			reinterpret_cast<ent_type*>(t->data)[row] = e;
+			return {t, row};
+		}
+		static void removeAt(const Location& l) {
+			Archetype& arch = _archetypes[l.chunk->archetype];
+			Chunk* t = arch.tail;
+			const index_type last = t->size - 1;
+			if (t != l.chunk || last != l.row) {
+				const ent_type moved = entity(t, last);
+				reinterpret_cast<ent_type*>(l.chunk->data)[l.row] = moved;
+				for (index_type c = 0; c < Params.MaxComponents; ++c)
+					if (arch.offset[c] >= 0)
+						memcpy(column(l.chunk, c, l.row), column(t, c, last), _bytes[c]);
+				_where[moved.id] = l;
+			}
+			if (--t->size == 0 && t->prev)
+				arch.tail = t->prev;
+		}
+
+		static inline size_type									_bytes[Params.MaxComponents];
+		static inline Bag<Archetype,	Params.MaxComponents>	_archetypes;
+		static inline Bag<Location,		Params.InitialEntities>	_where;
+		static inline struct Release {
+			~Release() {
+				for (index_type a = 0; a < _archetypes.size(); ++a)
+					for (Chunk* c = _archetypes[a].head; c != nullptr;) {
+						Chunk* next = c->next;
+						free(c);
+						c = next;
+					}
+			}
+		} _release;
+	};
+	template <class T>
+	class ArchetypeStorage final : NoInstance
+	{
+		static_assert(16 + sizeof(ent_type) + sizeof(T) <= sizeof(Archetypes::Chunk::data),
+			"component too large for an archetype chunk row");
+	public:
+		static void add(ent_type e, const T& t) {
+			Archetypes::declare(Component<T>::Index, sizeof(T));
+			Mask m = Archetypes::signature(e);
+			m.set(Component<T>::Bit);
+			Archetypes::move(e, m);
+			get(e) = t;
+		}
+		// rows move archetype one entity at a time
+		template <class F>
+		static void append(const ent_type* es, size_type n, F&& at) {
+			for (index_type i = 0; i < n; ++i)
+				add(es[i], at(i));
+		}
+		static void del(ent_type e) {
+			Mask m = Archetypes::signature(e);
+			m.clear(Component<T>::Bit);
+			Archetypes::move(e, m);
+		}
+		static T& get(ent_type e) {
+			return *reinterpret_cast<T*>(Archetypes::column(e, Component<T>::Index));
+		}
+		static T& get(Archetypes::Chunk* c, index_type row) {
+			return *reinterpret_cast<T*>(Archetypes::column(c, Component<T>::Index, row));
+		}
+		static void reserve(size_type entities, size_type) { Archetypes::reserve(entities); }
+		static void shrink(size_type) {}
+		static Usage usage() { return {}; } // rows live in the shared chunks
+		static constexpr size_type Spans = 0;
+		static RawSpan span(index_type) { return {}; }
+
+		static void save(Snapshot&, size_type) {}
+		static bool load(SnapshotReader&) { return true; }
+	};
+
 	class World final : NoInstance
 	{
 	public:
 		static ent_type createEntity() {
 			if (_ids.size() > 0)
 				return _ids.pop();
+			const id_type id = ++_maxId.id;
 			_masks.push(Mask{});
-			return {++_maxId.id};
+			_gens.push(id < _retired.size() ? _retired[id] + 1 : 0);
+			return {id, _gens[id]};
+		}
+		// `count` entities with the components Ts..., value-initialized and then filled in
+		// by init(i, Ts&...); ids, masks and every storage grow once for the whole batch,
+		// and each storage then takes all of its components in one append
+		template <class ...Ts, class F>
+		static void createEntities(size_type count, F&& init, ent_type* out = nullptr) {
+			const size_type entities = _maxId.id + 1 + std::max(count - _ids.size(), 0);
+			_masks.ensure(entities);
+			_gens.ensure(entities);
+			(Storage<Ts>::type::reserve(entities, count), ...);
+
+			std::vector<ent_type> ids(out ? 0 : count);
+			ent_type* es = out ? out : ids.data();
+			std::vector<std::tuple<Ts...>> rows(count);
+			for (index_type i = 0; i < count; ++i) {
+				es[i] = createEntity();
+				std::apply([&](Ts&... ts) { init(i, ts...); }, rows[i]);
+				(_masks[es[i].id].set(Component<Ts>::Bit), ...);
+			}
+			if (count > 0)
+				(setSingleton<Ts>(es[count - 1]), ...);
+			(Storage<Ts>::type::append(es, count, [&](index_type i) -> const Ts& { return std::get<Ts>(rows[i]); }), ...);
+		}
+		// room for `n` more entities, or for `n` more T on as many new entities, so a
+		// batch of known size spawns without growing a bag on the way
+		static void reserveEntities(size_type n) {
+			_masks.ensure(_maxId.id + 1 + n);
+			_gens.ensure(_maxId.id + 1 + n);
 		}
+		template <class T>
+		static void reserve(size_type n) {
+			Storage<T>::type::reserve(_maxId.id + 1 + n, n);
+		}
+		// hands every bag's capacity past what the live entities use back to the allocator
+		static void shrink() {
+			_masks.shrink();
+			_gens.shrink();
+			_ids.shrink();
+			_doomed.shrink();
+			_sweep.shrink();
+			shrink(Registered{});
+		}
+
 		static void destroyEntity(ent_type ent) {
+			if (!alive(ent))
+				return;
+			release(ent, Registered{});
+			Archetypes::erase(ent);
 			_masks[ent.id].clear();
-			_ids.push(ent);
+			_ids.push({ent.id, bump(ent.id)});
+		}
+		static void destroyEntities(const ent_type* ents, size_type n) {
+			_doomed.clear();
+			for (index_type i = 0; i < n; ++i) {
+				if (!alive(ents[i]))
+					continue;
+				bump(ents[i].id);
+				_doomed.push(ents[i]);
+			}
+			sweep(Registered{});
+			for (index_type i = 0; i < _doomed.size(); ++i) {
+				const id_type id = _doomed[i].id;
+				Archetypes::erase(_doomed[i]);
+				_masks[id].clear();
+				_ids.push({id, _gens[id]});
+			}
+		}
+		static bool alive(ent_type e) {
+			return e.id >= 0 && e.id <= _maxId.id && _gens[e.id] == e.gen;
+		}
+		static ent_type entity(id_type id) {
+			return {id, _gens[id]};
 		}
 		static const Mask& mask(ent_type e) {
 			return _masks[e.id];
 		}
 		static ent_type maxId() { return _maxId; }
 
+		template <class ...Ts>
+		static View<Ts...> view() { return View<Ts...>{}; }
+
 		template <class T>
-		static T& getComponent(ent_type e) {
+		static ent_type singleton() {
+			static_assert(IsTag<T>, "singleton() tracks TaggedStorage components only");
+			const ent_type e = _singletons[Component<T>::Index];
+			if (alive(e) && _masks[e.id].test(Component<T>::Bit))
+				return e;
+			return {-1};
+		}
+
+		template <class T>
+		static ref_type<T> getComponent(ent_type e) {
 			return Storage<T>::type::get(e);
 		}
 
+		// every storage, the masks and the free ids, packed back to back;
+		// the layout word ties a snapshot to the component set of this build
+		static void snapshot(Snapshot& s) {
+			const size_type entities = _maxId.id + 1;
+			s.clear();
+			s.put("BGLS", 4);
+			s.put(layout(Registered{}));
+			s.put(size_type{0});
+			s.put(_maxId);
+			s.bag(_masks);
+			s.bag(_gens);
+			s.bag(_ids);
+			s.put(_singletons, Params.MaxComponents);
+			save(s, entities, Registered{});
+			Archetypes::save(s);
+			s.patch(8, s.size());
+		}
+		static bool snapshot(const char* path) {
+			Snapshot s;
+			snapshot(s);
+			return s.save(path);
+		}
+
+		// false if the bytes aren't a whole snapshot of this build's layout; a
+		// snapshot that passes the header but is cut short leaves the world undefined
+		static bool restore(const void* data, size_t bytes) {
+			SnapshotReader r(data, bytes);
+			char magic[4];
+			std::uint32_t lay = 0;
+			size_type total = 0;
+			if (!r.get(magic, 4) || memcmp(magic, "BGLS", 4) != 0 || !r.get(lay) || lay != layout(Registered{})
+					|| !r.get(total) || static_cast<size_t>(total) != bytes)
+				return false;
+			retire();
+			const id_type last = _maxId.id;
+			if (!(r.get(_maxId) && r.bag(_masks) && r.bag(_gens) && r.bag(_ids)
+					&& r.get(_singletons, Params.MaxComponents) && load(r, Registered{}) && Archetypes::load(r)))
+				return false;
+			reissue(last);
+			return true;
+		}
+		static bool restore(const Snapshot& s) { return restore(s.data(), s.size()); }
+		static bool restore(const char* path) {
+			const MappedFile f(path);
+			return f.data() && restore(f.data(), f.size());
+		}
+
 		template <class T>
 		static void addComponent(ent_type e, const T& t) {
 			_masks[e.id].set(Component<T>::Bit);
+			setSingleton<T>(e);
 			Storage<T>::type::add(e,t);
 		}
 		template <class T, class...Ts>
@@ -264,23 +1220,155 @@ namespace bagel
 		}
 
 	private:
+		// the next generation of `id`, above any it reached before a restore rewound it
+		static gen_type bump(id_type id) {
+			const gen_type floor = id < _retired.size() ? _retired[id] : 0;
+			return _gens[id] = std::max(_gens[id], floor) + 1;
+		}
+		// a restore rewinds generations, so before it every id records the highest one it
+		// has reached; handles issued since the snapshot must not come back to life
+		static void retire() {
+			for (id_type id = _retired.size(); id <= _maxId.id; ++id)
+				_retired.push(0);
+			for (id_type id = 0; id <= _maxId.id; ++id)
+				_retired[id] = std::max(_retired[id], _gens[id]);
+		}
+		// after a restore: ids the snapshot doesn't know yet, and its free ids, are handed
+		// out next above their retired generation; `last` was the highest id before it
+		static void reissue(id_type last) {
+			for (index_type i = 0; i < _ids.size(); ++i) {
+				ent_type& e = _ids[i];
+				if (e.id < _retired.size() && e.gen <= _retired[e.id])
+					e.gen = _gens[e.id] = _retired[e.id] + 1;
+			}
+			if (!Params.DynamicResize && _ids.size() + last - _maxId.id > _ids.capacity())
+				return; // no room to free them: the ids past the snapshot stay unused
+			for (id_type id = _maxId.id + 1; id <= last; ++id) {
+				_masks.push(Mask{});
+				_gens.push(_retired[id] + 1);
+				_ids.push({id, _gens[id]});
+			}
+			_maxId.id = std::max(_maxId.id, last);
+		}
+
+		template <class ...Ts>
+		static std::uint32_t layout(TypeList<Ts...>) {
+			std::uint32_t h = 2166136261u;
+			const auto mix = [&h](std::uint32_t v) { h = (h ^ v) * 16777619u; };
+			mix(Params.DynamicResize);
+			mix(Params.IdBagSize);
+			mix(Params.InitialEntities);
+			mix(Params.InitialPackedSize);
+			mix(Params.MaxComponents);
+			mix(sizeof(Mask));
+			(mix(Component<Ts>::Index), ...);
+			(mix(sizeof(Ts)), ...);
+			return h;
+		}
+		template <class ...Ts>
+		static void save(Snapshot& s, size_type entities, TypeList<Ts...>) {
+			(Storage<Ts>::type::save(s, entities), ...);
+		}
+		template <class ...Ts>
+		static bool load(SnapshotReader& r, TypeList<Ts...>) {
+			return (Storage<Ts>::type::load(r) && ...);
+		}
+		template <class ...Ts>
+		static void release(ent_type e, TypeList<Ts...>) {
+			(releaseComponent<Ts>(e), ...);
+		}
+		template <class T>
+		static void releaseComponent(ent_type e) {
+			if constexpr (IsPacked<T>)
+				if (_masks[e.id].test(Component<T>::Bit))
+					Storage<T>::type::del(e);
+		}
+		template <class ...Ts>
+		static void shrink(TypeList<Ts...>) {
+			(Storage<Ts>::type::shrink(_maxId.id + 1), ...);
+		}
+		template <class ...Ts>
+		static void sweep(TypeList<Ts...>) {
+			(sweepComponent<Ts>(), ...);
+		}
+		// only tags name a singleton, so data components skip the write
+		template <class T>
+		static void setSingleton(ent_type e) {
+			if constexpr (IsTag<T>)
+				_singletons[Component<T>::Index] = e;
+		}
+		template <class T>
+		static void sweepComponent() {
+			if constexpr (IsPacked<T>) {
+				_sweep.clear();
+				for (index_type i = 0; i < _doomed.size(); ++i)
+					if (_masks[_doomed[i].id].test(Component<T>::Bit))
+						_sweep.push(Storage<T>::type::index(_doomed[i]));
+				std::sort(&_sweep[0], &_sweep[0] + _sweep.size(),
+					[](index_type a, index_type b) { return a > b; });
+				for (index_type i = 0; i < _sweep.size(); ++i)
+					Storage<T>::type::delAt(_sweep[i]);
+			}
+		}
+
 		static inline ent_type								_maxId{-1};
 		static inline Bag<Mask,		Params.InitialEntities> _masks;
+		static inline Bag<gen_type,	Params.InitialEntities> _gens;
+		static inline Bag<gen_type,	Params.InitialEntities> _retired;	// highest generation before a restore
 		static inline Bag<ent_type,	Params.IdBagSize>		_ids;
+		static inline Bag<ent_type,	Params.IdBagSize>		_doomed;
+		static inline Bag<index_type,	Params.IdBagSize>		_sweep;
+		static inline ent_type _singletons[Params.MaxComponents]{};
 	};
 
+	// one row of plain function pointers per BAGEL_STORAGE component, in bagel_cfg.h
+	// order, for passes that walk every storage at runtime: reports, tools, debugging
+	struct ComponentInfo
+	{
+		const char*			name;
+		const index_type*	index;		// Component<T>::Index, assigned at start-up
+		size_t				bytes;		// sizeof(T)
+		size_type			spans;		// span(i) for i below it: one per field for SoA, 0 for none
+		bool		(*has)(ent_type);
+		void		(*remove)(ent_type);	// no-op when the entity lacks it
+		Usage		(*usage)();
+		RawSpan		(*span)(index_type column);
+	};
+	template <class T>
+	constexpr ComponentInfo componentInfo() {
+		using S = typename Storage<T>::type;
+		return {Storage<T>::name, &Component<T>::Index, sizeof(T), S::Spans,
+			[](ent_type e) { return World::mask(e).test(Component<T>::Bit); },
+			[](ent_type e) {
+				if (World::mask(e).test(Component<T>::Bit))
+					World::delComponent<T>(e);
+			},
+			[] {
+				Usage u = S::usage();
+				u.name = Storage<T>::name;
+				return u;
+			},
+			&S::span};
+	}
+	template <class ...Ts>
+	constexpr std::array<ComponentInfo, sizeof...(Ts)> registry(TypeList<Ts...>) {
+		return {{componentInfo<Ts>()...}};
+	}
+	inline constexpr auto Components = registry(Registered{});
+
 	class Entity
 	{
 	public:
 		Entity(ent_type e) : _ent(e) {}
 		ent_type entity() const { return _ent; }
+		bool alive() const { return World::alive(_ent); }
 
 		static Entity create() { return World::createEntity(); }
 		void destroy() const { World::destroyEntity(_ent); }
 
 		const Mask& mask() const { return World::mask(_ent); }
 
-		template <class T> T& get() const { return World::getComponent<T>(_ent); }
+		template <class T> ref_type<T> get() const { return World::getComponent<T>(_ent); }
 		template <class T> void add(const T& t) const {
 			return World::addComponent<T>(_ent, t);
 		}
@@ -313,4 +1401,505 @@ namespace bagel
 	private:
 		Mask m;
 	};
+
+	template <class ...Ts>
+	class View
+	{
+	public:
+		using value_type = std::tuple<ent_type, ref_type<Ts>...>;
+
+		class iterator
+		{
+		public:
+			value_type operator*() const { return value_type{_cur, fetch<Ts>()...}; }
+			iterator& operator++() {
+				if (_view->_chunked) {
+					if (_chunk && _row < _chunk->size && Archetypes::entity(_chunk, _row).id == _cur.id)
+						++_row;
+				} else {
+					_last = std::min(_last, _view->_size());
+					if (_idx < _last && _view->_entity(_idx).id == _cur.id)
+						++_idx;
+				}
+				skip();
+				return *this;
+			}
+			bool operator==(const iterator& o) const {
+				return done() == o.done()
+					&& (done() || (_idx == o._idx && _chunk == o._chunk && _row == o._row));
+			}
+			bool operator!=(const iterator& o) const { return !(*this == o); }
+		private:
+			friend class View;
+			iterator(const View* v, index_type idx, index_type last)
+				: _view(v), _idx(idx), _last(last) {
+				if (_view->_chunked) {
+					--_idx;
+					nextArchetype();
+				}
+				skip();
+			}
+			void skip() {
+				if (_view->_chunked) {
+					while (!done()) {
+						for (; _row < _chunk->size; ++_row) {
+							_cur = Archetypes::entity(_chunk, _row);
+							if (World::mask(_cur).test(_view->_mask))
+								return;
+						}
+						_row = 0;
+						_chunk = _chunk->next;
+						if (!_chunk)
+							nextArchetype();
+					}
+					return;
+				}
+				for (; _idx < _last; ++_idx) {
+					_cur = _view->_entity(_idx);
+					if (World::mask(_cur).test(_view->_mask))
+						break;
+				}
+			}
+			void nextArchetype() {
+				_chunk = nullptr;
+				while (++_idx < _last) {
+					const Archetypes::Archetype& a = Archetypes::archetype(_idx);
+					if (a.head && a.mask.test(_view->_layout)) {
+						_chunk = a.head;
+						return;
+					}
+				}
+			}
+			template <class T>
+			ref_type<T> fetch() const {
+				if constexpr (IsArchetype<T>)
+					if (_chunk)
+						return ArchetypeStorage<T>::get(_chunk, _row);
+				return World::getComponent<T>(_cur);
+			}
+			bool done() const { return _idx >= _last; }
+
+			const View*			_view;
+			index_type			_idx;
+			index_type			_last;
+			Archetypes::Chunk*	_chunk = nullptr;
+			index_type			_row = 0;
+			ent_type			_cur{-1};
+		};
+
+		View() {
+			(drive<Ts>(), ...);
+			_chunked = _size == &allIds && !Mask{}.test(_layout);
+		}
+
+		template <class ...Us>
+		View with() const {
+			View v = *this;
+			(v.drive<Us>(), ...);
+			v._chunked = v._size == &allIds && !Mask{}.test(v._layout);
+			return v;
+		}
+
+		iterator begin() const { return {this, 0, _chunked ? Archetypes::count() : _size()}; }
+		iterator end() const {
+			const size_type n = _chunked ? Archetypes::count() : _size();
+			return {this, n, n};
+		}
+		bool empty() const { return begin() == end(); }
+
+		template <class F>
+		void each(F&& f) const {
+			for (auto it = begin(), last = end(); it != last; ++it)
+				std::apply(f, *it);
+		}
+		// candidates [first, last) of extent(): dense indices, or archetypes when chunked
+		template <class F>
+		void each(index_type first, index_type last, F&& f) const {
+			for (iterator it{this, first, last}, end{this, last, last}; it != end; ++it)
+				std::apply(f, *it);
+		}
+
+		size_type candidates() const { return _size(); }
+		size_type extent() const { return _chunked ? Archetypes::count() : _size(); }
+	private:
+		template <class T>
+		void drive() {
+			_mask.set(Component<T>::Bit);
+			if constexpr (IsArchetype<T>)
+				_layout.set(Component<T>::Bit);
+			if constexpr (IsPacked<T>) {
+				using S = typename Storage<T>::type;
+				if (_size == &allIds || S::size() < _size()) {
+					_size = &S::size;
+					_entity = &S::entity;
+				}
+			}
+		}
+		static size_type allIds() { return World::maxId().id + 1; }
+		static ent_type idAt(index_type idx) { return World::entity(idx); }
+
+		Mask		_mask;
+		Mask		_layout;
+		bool		_chunked = false;
+		size_type	(*_size)() = &allIds;
+		ent_type	(*_entity)(index_type) = &idAt;
+	};
+
+	// persistent workers, one range deque each: the owner takes chunks from the front,
+	// idle workers steal from the back of the others; the caller works as participant 0
+	class Jobs final : NoInstance
+	{
+	public:
+		static void start(int workers) {
+			stop();
+			_deques = std::make_unique<Deque[]>(workers + 1);
+			for (int i = 1; i <= workers; ++i)
+				_workers.emplace_back(loop, i);
+		}
+		static int workers() { return static_cast<int>(_workers.size()); }
+
+		// f(first, last) over [0, n) in chunks of `grain`; inline when there is no pool,
+		// a single chunk, or another run in progress
+		template <class F>
+		static void run(size_type n, size_type grain, F&& f) {
+			grain = std::max<size_type>(grain, 1);
+			const size_type chunks = (n + grain - 1) / grain;
+			if (chunks <= 1 || _workers.empty() || _running.exchange(true)) {
+				if (n > 0)
+					f(index_type{0}, n);
+				return;
+			}
+			struct Ctx { F& f; size_type n, grain; } ctx{f, n, grain};
+			const Job job{[](const void* c, index_type chunk) {
+				const Ctx& x = *static_cast<const Ctx*>(c);
+				x.f(chunk * x.grain, std::min(x.n, (chunk + 1) * x.grain));
+			}, &ctx};
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_idle.wait(lock, [] { return _busy == 0; });
+				const size_type p = workers() + 1;
+				for (size_type i = 0; i < p; ++i)
+					_deques[i].range.store(pack(chunks*i/p, chunks*(i+1)/p), std::memory_order_relaxed);
+				_remaining.store(chunks, std::memory_order_relaxed);
+				_job = job;
+				++_epoch;
+			}
+			_wake.notify_all();
+			work(0, job);
+			while (_remaining.load(std::memory_order_acquire) > 0)
+				std::this_thread::yield();
+			_running = false;
+		}
+	private:
+		struct Job
+		{
+			void		(*fn)(const void*, index_type);
+			const void*	ctx;
+		};
+		struct alignas(64) Deque
+		{
+			std::atomic<std::uint64_t>	range{0};	// chunks [lo, hi) as lo | hi<<32
+		};
+
+		static std::uint64_t pack(std::uint64_t lo, std::uint64_t hi) { return lo | hi << 32; }
+		static bool take(Deque& d, bool back, index_type& chunk) {
+			std::uint64_t r = d.range.load(std::memory_order_relaxed);
+			while (true) {
+				const std::uint64_t lo = r & 0xffffffff, hi = r >> 32;
+				if (lo >= hi)
+					return false;
+				const std::uint64_t next = back ? pack(lo, hi - 1) : pack(lo + 1, hi);
+				if (d.range.compare_exchange_weak(r, next, std::memory_order_acq_rel)) {
+					chunk = static_cast<index_type>(back ? hi - 1 : lo);
+					return true;
+				}
+			}
+		}
+		static void work(int self, const Job& job) {
+			const int p = workers() + 1;
+			index_type chunk;
+			while (true) {
+				bool found = take(_deques[self], false, chunk);
+				for (int k = 1; !found && k < p; ++k)
+					found = take(_deques[(self + k) % p], true, chunk);
+				if (!found)
+					return;
+				job.fn(job.ctx, chunk);
+				_remaining.fetch_sub(1, std::memory_order_release);
+			}
+		}
+		// a worker holding a job counts as busy until it runs dry, so the deques are
+		// never refilled under a worker still draining the previous job
+		static void loop(int self) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			std::uint64_t seen = _epoch;
+			while (true) {
+				_wake.wait(lock, [&] { return _stop || _epoch != seen; });
+				if (_stop)
+					return;
+				seen = _epoch;
+				const Job job = _job;
+				++_busy;
+				lock.unlock();
+				work(self, job);
+				lock.lock();
+				if (--_busy == 0)
+					_idle.notify_all();
+			}
+		}
+		static void stop() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (std::thread& t : _workers)
+				t.join();
+			_workers.clear();
+			_stop = false;
+		}
+
+		static inline std::unique_ptr<Deque[]>	_deques = std::make_unique<Deque[]>(1);
+		static inline std::vector<std::thread>	_workers;
+		static inline std::mutex				_mutex;
+		static inline std::condition_variable	_wake;
+		static inline std::condition_variable	_idle;
+		static inline Job						_job{};
+		static inline std::uint64_t				_epoch = 0;
+		static inline int						_busy = 0;
+		static inline bool						_stop = false;
+		static inline std::atomic<size_type>	_remaining{0};
+		static inline std::atomic<bool>			_running{false};
+		static inline struct Release {
+			~Release() { stop(); }
+		} _release;
+	};
+
+	// fn(entity, components...) for every entity of `view`, `grain` candidates per job
+	template <class ...Ts, class F>
+	void parallel_for(const View<Ts...>& view, size_type grain, F&& fn) {
+		Jobs::run(view.extent(), grain, [&](index_type first, index_type last) {
+			view.each(first, last, fn);
+		});
+	}
+
+	template <class ...Ts> struct Reads {};
+	template <class ...Ts> struct Writes {};
+
+	// a shared object that isn't a component (grids, command queues), named in
+	// Reads/Writes as Resource<T>; resources are numbered apart from components so
+	// they take no entity mask bits, up to 64 of them
+	inline index_type resCounter = -1;
+	template <class>
+	struct Resource final : NoInstance
+	{
+		static inline const index_type		Index = ++resCounter;
+	};
+
+	// what a system touches: component and resource types read and written, and
+	// whether it creates/destroys entities or adds/removes components
+	struct Access
+	{
+		Mask			reads;
+		Mask			writes;
+		std::uint64_t	readRes = 0;
+		std::uint64_t	writeRes = 0;
+		bool			structural = false;
+
+		static constexpr bool Structural = true;
+
+		template <class ...Rs, class ...Ws>
+		static Access of(Reads<Rs...>, Writes<Ws...>, bool structural = false) {
+			Access a;
+			(mark(a.reads, a.readRes, static_cast<Rs*>(nullptr)), ...);
+			(mark(a.writes, a.writeRes, static_cast<Ws*>(nullptr)), ...);
+			a.structural = structural;
+			return a;
+		}
+		bool conflicts(const Access& o) const {
+			return structural || o.structural || writes.intersects(o.writes)
+				|| writes.intersects(o.reads) || reads.intersects(o.writes)
+				|| (writeRes & (o.writeRes | o.readRes)) || (readRes & o.writeRes);
+		}
+	private:
+		template <class T>
+		static void mark(Mask& m, std::uint64_t&, T*) { m.set(Component<T>::Bit); }
+		template <class T>
+		static void mark(Mask&, std::uint64_t& res, Resource<T>*) { res |= std::uint64_t{1} << Resource<T>::Index; }
+	};
+
+	// runs systems in the order they were added, except that one may start as soon as
+	// every earlier system it conflicts with is done; with no workers it is that order
+	class Scheduler : NoCopy
+	{
+	public:
+		~Scheduler() { start(0); }
+
+		void start(int workers) {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (std::thread& t : _workers)
+				t.join();
+			_workers.clear();
+			_stop = false;
+			for (int i = 0; i < workers; ++i)
+				_workers.emplace_back([this] { work(); });
+		}
+		int workers() const { return static_cast<int>(_workers.size()); }
+
+		template <class F>
+		void add(const Access& a, F&& f) {
+			const index_type n = static_cast<index_type>(_tasks.size());
+			_tasks.push_back({a, std::forward<F>(f), 0, {}});
+			for (index_type i = 0; i < n; ++i)
+				if (_tasks[i].access.conflicts(a)) {
+					_tasks[i].next.push_back(n);
+					++_tasks[n].deps;
+				}
+		}
+		void clear() { _tasks.clear(); }
+
+		void run() {
+			if (_workers.empty()) {
+				for (Task& t : _tasks)
+					t.fn();
+				return;
+			}
+			std::unique_lock<std::mutex> lock(_mutex);
+			_ready.clear();
+			_left.resize(_tasks.size());
+			for (index_type i = 0; i < static_cast<index_type>(_tasks.size()); ++i)
+				if ((_left[i] = _tasks[i].deps) == 0)
+					_ready.push_back(i);
+			_pending = static_cast<index_type>(_tasks.size());
+			_wake.notify_all();
+			while (_pending > 0) {
+				_wake.wait(lock, [this] { return _pending == 0 || !_ready.empty(); });
+				if (_pending > 0)
+					execute(lock);
+			}
+		}
+	private:
+		struct Task
+		{
+			Access						access;
+			std::function<void()>		fn;
+			index_type					deps;
+			std::vector<index_type>		next;
+		};
+
+		// takes the earliest ready task; called and returns with the lock held
+		void execute(std::unique_lock<std::mutex>& lock) {
+			const auto first = std::min_element(_ready.begin(), _ready.end());
+			const index_type t = *first;
+			_ready.erase(first);
+			lock.unlock();
+			_tasks[t].fn();
+			lock.lock();
+			bool wake = --_pending == 0;
+			for (index_type n : _tasks[t].next)
+				if (--_left[n] == 0) {
+					_ready.push_back(n);
+					wake = true;
+				}
+			if (wake)
+				_wake.notify_all();
+		}
+		void work() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (true) {
+				_wake.wait(lock, [this] { return _stop || !_ready.empty(); });
+				if (_stop)
+					return;
+				execute(lock);
+			}
+		}
+
+		std::vector<Task>			_tasks;
+		std::vector<index_type>		_left;
+		std::vector<index_type>		_ready;
+		index_type					_pending = 0;
+		bool						_stop = false;
+		std::mutex					_mutex;
+		std::condition_variable		_wake;
+		std::vector<std::thread>	_workers;
+	};
+
+	class CommandBuffer : NoCopy
+	{
+	public:
+		ent_type create() { return {-2 - _created++}; }
+		template <class T, class ...Ts>
+		ent_type create(const T& t, const Ts&... ts) {
+			const ent_type e = create();
+			add(e, t);
+			(add(e, ts), ...);
+			return e;
+		}
+		void destroy(ent_type e) { _destroyed.push(e); }
+
+		template <class T>
+		void add(ent_type e, const T& t) {
+			static_assert(sizeof(T) <= PayloadSize, "component too large for CommandBuffer");
+			static_assert(std::is_trivially_copyable_v<T>, "CommandBuffer copies components bytewise");
+			Command c{&applyAdd<T>, e, {}};
+			memcpy(c.payload, &t, sizeof(T));
+			_commands.push(c);
+		}
+		template <class T>
+		void del(ent_type e) {
+			_commands.push(Command{&applyDel<T>, e, {}});
+		}
+
+		void flush() {
+			_resolved.clear();
+			for (index_type i = 0; i < _created; ++i)
+				_resolved.push(World::createEntity());
+			for (index_type i = 0; i < _commands.size(); ++i) {
+				const Command& c = _commands[i];
+				const ent_type e = resolve(c.ent);
+				if (World::alive(e))
+					c.apply(e, c.payload);
+			}
+			for (index_type i = 0; i < _destroyed.size(); ++i)
+				_destroyed[i] = resolve(_destroyed[i]);
+			World::destroyEntities(&_destroyed[0], _destroyed.size());
+
+			_created = 0;
+			_commands.clear();
+			_destroyed.clear();
+		}
+		bool empty() const {
+			return _created == 0 && _commands.size() == 0 && _destroyed.size() == 0;
+		}
+	private:
+		static constexpr size_type PayloadSize = 32;
+		struct Command {
+			void		(*apply)(ent_type, const unsigned char*);
+			ent_type	ent;
+			alignas(std::max_align_t) unsigned char payload[PayloadSize];
+		};
+
+		template <class T>
+		static void applyAdd(ent_type e, const unsigned char* payload) {
+			T t;
+			memcpy(&t, payload, sizeof(T));
+			World::addComponent(e, t);
+		}
+		template <class T>
+		static void applyDel(ent_type e, const unsigned char*) {
+			World::delComponent<T>(e);
+		}
+		ent_type resolve(ent_type e) const {
+			return e.id <= -2 ? _resolved[-2 - e.id] : e;
+		}
+
+		size_type								_created = 0;
+		Bag<ent_type,Params.InitialEntities>	_resolved;
+		Bag<Command,Params.InitialEntities>		_commands;
+		Bag<ent_type,Params.InitialEntities>	_destroyed;
+	};
 }
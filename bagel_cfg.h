@@ -9,20 +9,29 @@ constexpr Bagel Params {
     .IdBagSize          = 16,
     .InitialEntities    = 64,
     .InitialPackedSize  = 32,
-    .MaxComponents      = 32
+    .MaxComponents      = 64,   // 34 component and tag types in the game, more in tests
+    // arena: bags grow in place, references into them survive growth (needs mmap, else heap)
+    .Allocation         = ArenaAvailable ? Memory::Arena : Memory::Heap
 };
 
+// storages: SparseStorage, PackedStorage, SoAPackedStorage, TaggedStorage, or ArchetypeStorage
+// (entities sharing the same set of archetype components live in 16 KB chunks)
+
 // — sparse storage
 BAGEL_STORAGE(element::UIIntent,     SparseStorage)
 BAGEL_STORAGE(element::MouseInput,   SparseStorage)
 BAGEL_STORAGE(element::CurrentLevel, SparseStorage)
 BAGEL_STORAGE(element::SpawnState,   SparseStorage)
+BAGEL_STORAGE(element::Tint,         SparseStorage)
+
+// — packed storage, one column per field (see Fields below)
+BAGEL_STORAGE(element::Transform,     SoAPackedStorage)
 
 // — packed storage
-BAGEL_STORAGE(element::Transform,     PackedStorage)
 BAGEL_STORAGE(element::Drawable,      PackedStorage)
 BAGEL_STORAGE(element::Velocity,      PackedStorage)
 BAGEL_STORAGE(element::WaypointIndex, PackedStorage)
+BAGEL_STORAGE(element::PathProgress,  PackedStorage)
 BAGEL_STORAGE(element::HP,            PackedStorage)
 BAGEL_STORAGE(element::Gold,          PackedStorage)
 BAGEL_STORAGE(element::Gold_Bounty,   PackedStorage)
@@ -45,4 +54,10 @@ BAGEL_STORAGE(element::NextLevel_Tag,    TaggedStorage)
 BAGEL_STORAGE(element::GameState_Tag,    TaggedStorage)
 BAGEL_STORAGE(element::SpawnManager_Tag, TaggedStorage)
 BAGEL_STORAGE(element::Bullet_Tag,       TaggedStorage)
+
+// — field lists for SoAPackedStorage; ref members follow the same order
+template <> struct Fields<element::Transform> {
+    static constexpr auto members = std::make_tuple(&element::Transform::p, &element::Transform::a);
+    struct ref {SDL_FPoint &p; float &a;};
+};
 // @formatter:on
@@ -0,0 +1,162 @@
+// bench.cpp file
+// BAGEL_bench: every logic system of Element.cpp and the whole tick, on worlds of
+// 1k/10k/100k creeps with towers beside the path, written as google-benchmark JSON.
+//   BAGEL_bench [--filter text] [--min-time s] [--towers N] [--threads N] [--out file.json]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Element.h"
+#include "bagel.h"
+
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "" // set by CMake from CMAKE_BUILD_TYPE
+#endif
+
+using namespace bagel;
+using namespace element;
+
+namespace {
+	constexpr int SIZES[] = {1000, 10000, 100000};
+	constexpr int WARMUP_TICKS = 120; // every tower has fired and bullets are in flight
+
+	struct Result
+	{
+		std::string	name;
+		long		iterations;
+		double		realNs;		// per iteration
+		double		cpuNs;
+		int			entities;
+	};
+
+	struct Clock
+	{
+		std::chrono::steady_clock::time_point	wall;
+		std::clock_t							cpu;
+
+		static Clock now() { return {std::chrono::steady_clock::now(), std::clock()}; }
+	};
+
+	// repeats `timed` on a freshly restored world until `minTime` seconds were spent in
+	// it, or ten times that in the untimed `before`/`after`, which run so every
+	// iteration sees the same input
+	template <class Before, class Timed, class After>
+	Result measure(std::string name, const Snapshot& state, double minTime,
+			Before&& before, Timed&& timed, After&& after) {
+		const auto begin = std::chrono::steady_clock::now();
+		double wall = 0, cpu = 0;
+		long iterations = 0;
+		while (iterations < 10 || (wall < minTime &&
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() < 10*minTime)) {
+			World::restore(state);
+			before();
+			const Clock start = Clock::now();
+			timed();
+			const Clock end = Clock::now();
+			after();
+			wall += std::chrono::duration<double>(end.wall - start.wall).count();
+			cpu += static_cast<double>(end.cpu - start.cpu) / CLOCKS_PER_SEC;
+			++iterations;
+		}
+		return {std::move(name), iterations, wall / iterations * 1e9, cpu / iterations * 1e9, 0};
+	}
+
+	void writeJson(std::FILE* f, const char* exe, const std::vector<Result>& results) {
+		char date[32];
+		const std::time_t t = std::time(nullptr);
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&t));
+
+		std::fprintf(f, "{\n  \"context\": {\n");
+		std::fprintf(f, "    \"date\": \"%s\",\n", date);
+		std::fprintf(f, "    \"executable\": \"%s\",\n", exe);
+		std::fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+		std::fprintf(f, "    \"library_build_type\": \"%s\"\n", *BENCH_BUILD_TYPE ? BENCH_BUILD_TYPE : "unknown");
+		std::fprintf(f, "  },\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& r = results[i];
+			std::fprintf(f, "    {\n");
+			std::fprintf(f, "      \"name\": \"%s\",\n", r.name.c_str());
+			std::fprintf(f, "      \"run_name\": \"%s\",\n", r.name.c_str());
+			std::fprintf(f, "      \"run_type\": \"iteration\",\n");
+			std::fprintf(f, "      \"iterations\": %ld,\n", r.iterations);
+			std::fprintf(f, "      \"real_time\": %.3f,\n", r.realNs);
+			std::fprintf(f, "      \"cpu_time\": %.3f,\n", r.cpuNs);
+			std::fprintf(f, "      \"time_unit\": \"ns\",\n");
+			std::fprintf(f, "      \"entities\": %d,\n", r.entities);
+			std::fprintf(f, "      \"items_per_second\": %.3f\n", r.entities / (r.realNs * 1e-9));
+			std::fprintf(f, "    }%s\n", i + 1 < results.size() ? "," : "");
+		}
+		std::fprintf(f, "  ]\n}\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* filter = "";
+	const char* out = nullptr;
+	double minTime = 0.5;
+	int towers = -1; // creeps / 10
+	int threads = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			minTime = atof(argv[++i]);
+		else if (strcmp(argv[i], "--towers") == 0 && i + 1 < argc)
+			towers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			out = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+	}
+
+	Options opts;
+	opts.headless = true;
+	opts.threads = threads;
+	const Element game(opts);
+
+	Snapshot empty, state;
+	World::snapshot(empty);
+	std::vector<Result> results;
+	const auto run = [&](std::string name, int entities, auto&& before, auto&& timed, auto&& after) {
+		if (name.find(filter) == std::string::npos)
+			return;
+		Result r = measure(std::move(name), state, minTime, before, timed, after);
+		r.entities = entities;
+		std::fprintf(stderr, "%-28s %12.0f ns %10ld it\n", r.name.c_str(), r.realNs, r.iterations);
+		results.push_back(std::move(r));
+	};
+
+	for (const int creeps: SIZES) {
+		World::restore(empty);
+		game.populate(creeps, towers < 0 ? creeps / 10 : towers);
+		for (int i = 0; i < WARMUP_TICKS; ++i)
+			game.step();
+		World::snapshot(state);
+		const int entities = World::maxId().id + 1;
+		const std::string size = "/" + std::to_string(creeps);
+
+		// each system gets the input the tick feeds it: the ones before it run untimed
+		for (int s = 0; s < Element::LOGIC_SYSTEM_COUNT; ++s)
+			run(Element::logicSystemName(s) + size, entities,
+				[&] { for (int i = 0; i < s; ++i) game.runLogicSystem(i); },
+				[&] { game.runLogicSystem(s); },
+				[&] { for (int i = s + 1; i < Element::LOGIC_SYSTEM_COUNT; ++i) game.runLogicSystem(i); });
+		run("tick" + size, entities, [] {}, [&] { game.step(); }, [] {});
+	}
+
+	std::FILE* f = out ? std::fopen(out, "w") : stdout;
+	if (!f) {
+		std::fprintf(stderr, "cannot write %s\n", out);
+		return 1;
+	}
+	writeJson(f, argv[0], results);
+	if (f != stdout)
+		std::fclose(f);
+	return 0;
+}
@@ -3,10 +3,38 @@
 
 using namespace element;
 
-int main() {
-	Element p;
-	p.run();
-	return 0;
+// [--headless [--frames N] [--script input.txt]] [--profile-csv out.csv] [--uncapped]
+// [--record out.rpl] | [--replay in.rpl] [--threads N] [--memory-report]
+// --gen-tables res/tables.h   (regenerate the compiled-in tower/wave tables and exit)
+int main(int argc, char *argv[]) {
+	Options opts;
+	for (int i = 1; i < argc; ++i) {
+		if (SDL_strcmp(argv[i], "--gen-tables") == 0 && i + 1 < argc) {
+			Tables t;
+			return loadTables(TOWERS_CSV, WAVES_CSV, t) && writeTablesHeader(t, argv[++i]) ? 0 : 1;
+		}
+		else if (SDL_strcmp(argv[i], "--headless") == 0)
+			opts.headless = true;
+		else if (SDL_strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			opts.frames = SDL_atoi(argv[++i]);
+		else if (SDL_strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+			opts.script = loadInputScript(argv[++i]);
+		else if (SDL_strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+			opts.profileCsv = argv[++i];
+		else if (SDL_strcmp(argv[i], "--uncapped") == 0)
+			opts.uncapped = true;
+		else if (SDL_strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			opts.record = argv[++i];
+		else if (SDL_strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			opts.replay = argv[++i];
+		else if (SDL_strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			opts.threads = SDL_atoi(argv[++i]);
+		else if (SDL_strcmp(argv[i], "--memory-report") == 0)
+			opts.memoryReport = true;
+	}
+
+	Element p(std::move(opts));
+	return p.run();
 }
 
 
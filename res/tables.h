@@ -0,0 +1,92 @@
+/* Auto-generated from "Towers and Waves - *.csv" (--gen-tables) - DO NOT EDIT MANUALLY */
+#pragma once
+
+inline constexpr element::Tables GENERATED_TABLES = {
+    { // towers[kind][tier - 1]: cost, damage, range, fireInterval
+        { // Arrow
+            {7, 6, 100.000000f, 0.500000f},
+            {13, 16, 110.000000f, 0.500000f},
+            {32, 26, 125.000000f, 0.500000f},
+            {0, 0, 0.000000f, 0.000000f},
+        },
+        { // Cannon
+            {9, 9, 70.000000f, 0.500000f},
+            {15, 24, 70.000000f, 0.500000f},
+            {26, 50, 70.000000f, 0.500000f},
+            {0, 0, 0.000000f, 0.000000f},
+        },
+        { // Air
+            {12, 20, 120.000000f, 0.500000f},
+            {20, 35, 120.000000f, 0.500000f},
+            {30, 56, 120.000000f, 0.500000f},
+            {0, 0, 0.000000f, 0.000000f},
+        },
+        { // Water
+            {50, 25, 75.000000f, 0.500000f},
+            {25, 30, 75.000000f, 0.500000f},
+            {25, 35, 75.000000f, 0.500000f},
+            {25, 40, 75.000000f, 0.500000f},
+        },
+        { // Earth
+            {50, 144, 100.000000f, 3.000000f},
+            {75, 288, 110.000000f, 3.000000f},
+            {100, 576, 120.000000f, 3.000000f},
+            {150, 1152, 130.000000f, 3.000000f},
+        },
+        { // Fire
+            {50, 75, 100.000000f, 1.000000f},
+            {75, 175, 100.000000f, 1.000000f},
+            {100, 300, 100.000000f, 1.000000f},
+            {150, 400, 100.000000f, 1.000000f},
+        },
+        { // Rocket
+            {200, 2000, 170.000000f, 2.000000f},
+            {190, 2000, 170.000000f, 1.000000f},
+            {0, 0, 0.000000f, 0.000000f},
+            {0, 0, 0.000000f, 0.000000f},
+        },
+    },
+    {3, 3, 3, 4, 4, 4, 2},
+    { // waves[level - 1]: hp, gold, count, flags
+        {10, 1, 20, 0u},
+        {42, 1, 20, 0u},
+        {65, 1, 20, 0u},
+        {75, 1, 20, 0u},
+        {101, 1, 20, 0u},
+        {87, 1, 20, 1u},
+        {135, 1, 20, 0u},
+        {158, 1, 20, 2u},
+        {189, 1, 20, 0u},
+        {212, 2, 20, 4u},
+        {2000, 45, 1, 8u},
+        {246, 2, 20, 0u},
+        {212, 2, 20, 1u},
+        {331, 2, 20, 0u},
+        {384, 2, 20, 0u},
+        {445, 2, 20, 0u},
+        {580, 2, 20, 2u},
+        {695, 2, 20, 0u},
+        {559, 2, 20, 1u},
+        {806, 3, 20, 0u},
+        {1125, 3, 20, 4u},
+        {14000, 55, 1, 8u},
+        {1075, 3, 20, 0u},
+        {1265, 4, 20, 0u},
+        {1468, 4, 20, 0u},
+        {1265, 4, 20, 1u},
+        {1615, 4, 20, 2u},
+        {1935, 4, 20, 0u},
+        {2165, 5, 20, 0u},
+        {2405, 5, 20, 0u},
+        {2655, 5, 20, 0u},
+        {2500, 2, 20, 5u},
+        {35000, 100, 1, 8u},
+        {5000, 5, 40, 0u},
+        {7000, 10, 40, 0u},
+        {10000, 15, 40, 0u},
+        {15000, 20, 40, 0u},
+        {20000, 25, 40, 0u},
+        {25001, 30, 60, 0u},
+    },
+    39
+};
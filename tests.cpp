@@ -1,11 +1,26 @@
 // tests.cpp file
+#include <atomic>
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include "Element.h"
+#include "Tables.h"
 #include "bagel.h"
 
 using namespace std;
 using namespace bagel;
 
+struct ArchPos { float x, y; };
+struct ArchVel { float x, y; };
+struct OnlyTag {};
+template <int N> struct ArchBit { int n; };
+namespace bagel {
+	template <> struct Storage<ArchPos> { using type = ArchetypeStorage<ArchPos>; };
+	template <> struct Storage<ArchVel> { using type = ArchetypeStorage<ArchVel>; };
+	template <int N> struct Storage<ArchBit<N>> { using type = ArchetypeStorage<ArchBit<N>>; };
+	template <> struct Storage<OnlyTag> { using type = TaggedStorage<OnlyTag>; };
+}
+
 
 void test1() {
 	ent_type e0 = World::createEntity();
@@ -45,6 +60,13 @@ void test_DynamicBag() {
 	assert(last == 30);
 	assert(bag.size() == 2);
 
+	// The high-water mark stays, shrinking gives capacity back down to the contents
+	assert(bag.peak() == 3);
+	bag.ensure(100);
+	assert(bag.capacity() >= 100);
+	bag.shrink();
+	assert(bag.capacity() == 2 && bag[1] == 20);
+
 	cout << "test_DynamicBag passed\n";
 }
 
@@ -69,8 +91,729 @@ void test_PackedStorage() {
 	cout << "test_PackedStorage passed\n";
 }
 
+void test_View() {
+	using element::Transform;
+	using element::Velocity;
+	using element::Creep_Tag;
+
+	Entity a = Entity::create();
+	a.addAll(Transform{{1,1},0}, Velocity{{1,0}});
+	Entity b = Entity::create();
+	b.addAll(Transform{{2,2},0});
+	Entity c = Entity::create();
+	c.addAll(Transform{{3,3},0}, Velocity{{0,1}}, Creep_Tag{});
+
+	// Only entities holding every requested component are visited
+	int count = 0;
+	for (auto [e, t, v] : World::view<Transform, Velocity>()) {
+		assert((e.id == a.entity().id || e.id == c.entity().id));
+		assert(&t.p == &a.get<Transform>().p || &t.p == &c.get<Transform>().p);
+		(void)v;
+		++count;
+	}
+	assert(count == 2);
+
+	// Tags narrow the view, components are yielded by reference
+	World::view<Velocity>().with<Creep_Tag>().each([&](ent_type e, Velocity& v) {
+		assert(e.id == c.entity().id);
+		v.v.x = 5;
+	});
+	assert(c.get<Velocity>().v.x == 5);
+
+	// Driven by the smallest backing storage
+	const auto moving = World::view<Transform, Velocity>();
+	assert(moving.candidates() == PackedStorage<Velocity>::size());
+
+	a.destroy();
+	b.destroy();
+	c.destroy();
+	cout << "test_View passed\n";
+}
+
+void test_DestroyReleasesComponents() {
+	using element::Transform;
+	using element::Velocity;
+
+	const int transforms = Storage<Transform>::type::size();
+	const int velocities = PackedStorage<Velocity>::size();
+
+	Entity a = Entity::create();
+	a.addAll(Transform{{1,1},0}, Velocity{{1,0}});
+	Entity b = Entity::create();
+	b.addAll(Transform{{2,2},0});
+	assert(Storage<Transform>::type::size() == transforms + 2);
+
+	// Destroying releases exactly the components the entity holds
+	a.destroy();
+	assert(Storage<Transform>::type::size() == transforms + 1);
+	assert(PackedStorage<Velocity>::size() == velocities);
+	assert(b.get<Transform>().p.x == 2);
+
+	// Recycling the id does not grow the dense arrays
+	for (int i = 0; i < 100; ++i) {
+		Entity e = Entity::create();
+		e.addAll(Transform{{0,0},0}, Velocity{{0,0}});
+		e.destroy();
+	}
+	assert(Storage<Transform>::type::size() == transforms + 1);
+
+	// The current entity may be destroyed while iterating a view
+	for (int i = 0; i < 4; ++i)
+		Entity::create().addAll(Transform{{0,0},0}, Velocity{{float(i),0}});
+	int visited = 0;
+	for (auto [e, v] : World::view<Velocity>()) {
+		(void)v;
+		World::destroyEntity(e);
+		++visited;
+	}
+	assert(visited == 4);
+	assert(PackedStorage<Velocity>::size() == velocities);
+
+	b.destroy();
+	cout << "test_DestroyReleasesComponents passed\n";
+}
+
+void test_Generations() {
+	Entity a = Entity::create();
+	const ent_type stale = a.entity();
+	assert(World::alive(stale));
+
+	a.destroy();
+	assert(!World::alive(stale) && "Destroyed handle still alive");
+
+	// The id is recycled, the stale handle must not alias the newcomer
+	Entity b = Entity::create();
+	assert(b.entity().id == stale.id);
+	assert(b.alive());
+	assert(!World::alive(stale) && "Stale handle aliases recycled id");
+
+	assert(!World::alive(ent_type{-1}));
+
+	// destroying through the stale handle leaves the newcomer and its components alone
+	World::addComponent(b.entity(), element::HP{3, 3});
+	a.destroy();
+	World::destroyEntity(stale);
+	assert(b.alive() && b.get<element::HP>().current == 3);
+
+	// a repeated destroy frees the id once: the next two creates get different ids
+	b.destroy();
+	b.destroy();
+	Entity c = Entity::create(), d = Entity::create();
+	assert(c.entity().id != d.entity().id);
+
+	c.destroy();
+	d.destroy();
+	cout << "test_Generations passed\n";
+}
+
+void test_CommandBuffer() {
+	using element::Transform;
+	using element::Velocity;
+
+	const int transforms = Storage<Transform>::type::size();
+	CommandBuffer cmds;
+
+	// Creation is invisible until the flush
+	cmds.create(Transform{{7,7},0}, Velocity{{1,1}});
+	assert(Storage<Transform>::type::size() == transforms);
+	cmds.flush();
+	assert(cmds.empty());
+	assert(Storage<Transform>::type::size() == transforms + 1);
+
+	Entity made = Storage<Transform>::type::entity(transforms);
+	assert(made.alive() && made.has<Velocity>());
+	assert(made.get<Transform>().p.x == 7);
+
+	// Batched destroys, duplicates and stale handles are ignored
+	ent_type ents[6] = {made.entity()};
+	for (int i = 1; i < 6; ++i) {
+		ents[i] = World::createEntity();
+		World::addComponent(ents[i], Transform{{float(i),0},0});
+	}
+	const ent_type keep = ents[3];
+	for (int i : {0, 5, 1, 5, 2, 4})
+		cmds.destroy(ents[i]);
+	cmds.add(keep, Velocity{{3,3}});
+	cmds.flush();
+
+	assert(Storage<Transform>::type::size() == transforms + 1);
+	assert(World::alive(keep) && !World::alive(ents[5]));
+	assert(World::getComponent<Transform>(keep).p.x == 3);
+	assert(World::getComponent<Velocity>(keep).v.x == 3);
+	assert(Storage<Transform>::type::entity(transforms).id == keep.id);
+
+	cmds.destroy(keep);
+	cmds.flush();
+	assert(Storage<Transform>::type::size() == transforms);
+	cout << "test_CommandBuffer passed\n";
+}
+
+void test_ArchetypeStorage() {
+	constexpr int N = 2000;
+	ent_type ents[N];
+	for (int i = 0; i < N; ++i) {
+		ents[i] = World::createEntity();
+		World::addComponent(ents[i], ArchPos{float(i), 0});
+		if (i % 2 == 0)
+			World::addComponent(ents[i], ArchVel{1, float(i)});
+	}
+
+	// Moving between archetypes keeps the shared components
+	for (int i = 0; i < N; ++i) {
+		assert(World::getComponent<ArchPos>(ents[i]).x == float(i));
+		if (i % 2 == 0)
+			assert(World::getComponent<ArchVel>(ents[i]).y == float(i));
+	}
+
+	// Rows of one chunk are laid out as contiguous columns
+	assert(&World::getComponent<ArchPos>(ents[3]) == &World::getComponent<ArchPos>(ents[1]) + 1);
+
+	int count = 0;
+	World::view<ArchPos, ArchVel>().each([&](ent_type, ArchPos& p, ArchVel& v) {
+		p.x += v.x;
+		++count;
+	});
+	assert(count == N/2);
+	assert(World::getComponent<ArchPos>(ents[0]).x == 1);
+	assert(World::getComponent<ArchPos>(ents[1]).x == 1);
+
+	World::delComponent<ArchVel>(ents[0]);
+	assert(!Entity(ents[0]).has<ArchVel>());
+	assert(World::getComponent<ArchPos>(ents[0]).x == 1);
+
+	// The current entity may be destroyed while iterating the chunks
+	count = 0;
+	for (auto [e, p] : World::view<ArchPos>()) {
+		assert(p.x >= 0);
+		World::destroyEntity(e);
+		++count;
+	}
+	assert(count == N);
+	assert(World::view<ArchPos>().empty());
+	cout << "test_ArchetypeStorage passed\n";
+}
+
+void test_SoAPackedStorage() {
+	using element::Transform;
+	using TransformStorage = SoAPackedStorage<Transform>;
+
+	const int transforms = TransformStorage::size();
+	Entity a = Entity::create();
+	a.add(Transform{{1,2},30});
+	Entity b = Entity::create();
+	b.add(Transform{{3,4},60});
+
+	// Fields live in separate contiguous columns
+	const auto points = TransformStorage::column<0>();
+	const auto angles = TransformStorage::column<1>();
+	assert(points.size == transforms + 2 && angles.size == transforms + 2);
+	assert(&points[transforms + 1] == &points[transforms] + 1);
+	assert(points[transforms + 1].x == 3 && angles[transforms + 1] == 60);
+
+	// The proxy writes through to the columns
+	auto t = b.get<Transform>();
+	t.p.x = 5;
+	t.a = 90;
+	assert(points[transforms + 1].x == 5 && angles[transforms + 1] == 90);
+
+	// Swap-removal moves every field of the last entity
+	a.destroy();
+	assert(TransformStorage::size() == transforms + 1);
+	const Transform loaded = TransformStorage::load(TransformStorage::index(b.entity()));
+	assert(loaded.p.x == 5 && loaded.p.y == 4 && loaded.a == 90);
+
+	b.destroy();
+	cout << "test_SoAPackedStorage passed\n";
+}
+
+void test_SpatialGrid() {
+	using element::SpatialGrid;
+
+	// 10x10 cells of 10 units, plus entries clamped in from outside the bounds
+	SpatialGrid grid({0, 0, 100, 100}, 10, 10);
+	grid.insert({0}, {5, 5}, 0);
+	grid.insert({1}, {14, 5}, 1);
+	grid.insert({2}, {55, 55}, 2);
+	grid.insert({3}, {-20, 3}, 3);
+	grid.insert({4}, {95, 95}, 4);
+	grid.build();
+	assert(grid.size() == 5);
+
+	int found = 0;
+	grid.queryCircle({10, 5}, 5, [&](const SpatialGrid::Entry &en) { found |= 1 << en.data; });
+	assert(found == 0b00011);
+
+	found = 0;
+	grid.queryCircle({0, 0}, 30, [&](const SpatialGrid::Entry &en) { found |= 1 << en.data; });
+	assert(found == 0b01011);
+
+	// rebuilding drops the previous frame's entries
+	grid.clear();
+	grid.insert({2}, {55, 55}, 2);
+	grid.build();
+	found = 0;
+	grid.queryCircle({50, 50}, 100, [&](const SpatialGrid::Entry &en) { found |= 1 << en.data; });
+	assert(found == 0b00100);
+
+	// sorted cells: queryBest returns the first in-range entry by the order, ties by insertion
+	const auto higher = [](const SpatialGrid::Entry &a, const SpatialGrid::Entry &b) { return a.data > b.data; };
+	grid.clear();
+	grid.insert({0}, {1, 1}, 7);	// out of range, though first in its cell
+	grid.insert({1}, {8, 8}, 3);
+	grid.insert({2}, {9, 9}, 5);
+	grid.insert({3}, {7, 7}, 5);
+	grid.insert({4}, {15, 5}, 4);
+	grid.insert({5}, {15, 6}, 9);	// out of range
+	grid.build(higher);
+	assert(grid.queryBest({8, 8}, 3, higher)->e.id == 2);
+	assert(grid.queryBest({10, 8}, 6, higher)->e.id == 5);
+	assert(grid.queryBest({16, 4}, 1.5f, higher)->e.id == 4);
+	assert(!grid.queryBest({50, 50}, 5, higher));
+
+	// a cell whose leading run lies off the circle: skipped by its box, the next run still found
+	grid.clear();
+	for (int i = 0; i < 40; ++i)
+		grid.insert({i}, {i < 20 ? 71.f : 79.f, 71.f + i % 8}, 100 - i);
+	grid.build(higher);
+	assert(grid.queryBest({79, 75}, 2, higher)->e.id == 20);
+	assert(grid.queryBest({71, 75}, 2, higher)->e.id == 2);
+	cout << "test_SpatialGrid passed\n";
+}
+
+void test_PathTable() {
+	using namespace element;
+
+	// the table is built at compile time
+	static_assert(PATH.s[0] == 0 && PATH_LENGTH > 0);
+
+	float sum = 0;
+	for (int i = 1; i < TURN_COUNT; ++i) {
+		const float dx = TURNS[i].x - TURNS[i-1].x, dy = TURNS[i].y - TURNS[i-1].y;
+		const float len = sqrtf(dx*dx + dy*dy);
+		sum += len;
+		assert(fabsf(PATH.s[i] - sum) < 1e-2f);
+		assert(fabsf(PATH.dir[i].x * len - dx) < 1e-3f && fabsf(PATH.dir[i].y * len - dy) < 1e-3f);
+	}
+	assert(fabsf(PATH_LENGTH - sum) < 1e-2f);
+	cout << "test_PathTable passed\n";
+}
+
+void test_Singleton() {
+	assert(World::singleton<OnlyTag>().id == -1);
+
+	Entity a = Entity::create();
+	a.add(OnlyTag{});
+	assert(World::singleton<OnlyTag>().id == a.entity().id);
+
+	// invalidated by removing the tag or destroying the holder
+	a.del<OnlyTag>();
+	assert(World::singleton<OnlyTag>().id == -1);
+	a.add(OnlyTag{});
+	a.destroy();
+	assert(World::singleton<OnlyTag>().id == -1);
+
+	// a recycled id does not inherit the registration
+	Entity b = Entity::create();
+	assert(b.entity().id == a.entity().id && World::singleton<OnlyTag>().id == -1);
+	b.add(OnlyTag{});
+	assert(World::singleton<OnlyTag>().gen == b.entity().gen);
+	b.destroy();
+	cout << "test_Singleton passed\n";
+}
+
+void test_Tables() {
+	using namespace element;
+
+	Tables t;
+	assert(loadTables(TOWERS_CSV, WAVES_CSV, t));
+
+	const TowerStats &arrow = t.tower(TowerKind::Arrow, 1);
+	assert(arrow.cost == 7 && arrow.damage == 6 && arrow.range == 100 && arrow.fireInterval == 0.5f);
+	// padded names ("Water 2 ") and quoted fields with commas (Fire 2) keep their columns
+	assert(t.tiers[int(TowerKind::Water)] == 4 && t.tower(TowerKind::Water, 2).damage == 30);
+	assert(t.tower(TowerKind::Fire, 2).damage == 175 && t.tower(TowerKind::Fire, 2).fireInterval == 1.0f);
+	assert(t.tiers[int(TowerKind::Rocket)] == 2);
+
+	assert(t.waveCount == 39);
+	assert(t.waves[0].hp == 10 && t.waves[0].count == 20);
+	assert(t.waves[10].flags == WAVE_BOSS && t.waves[10].count == 1);
+	assert(t.waves[31].flags == (WAVE_FAST | WAVE_IMMUNE));
+	cout << "test_Tables passed\n";
+}
+
+void test_TileGrid() {
+	using namespace element;
+
+	TileGrid tiles;
+	assert(tiles.load("res/flash_elemnt_map.txt"));
+
+	// every way-point of the creep path lies on road
+	for (const TurnPt &t: TURNS) {
+		const int c = int((t.x - Element::MAP_TEX_PAD_X) / TileGrid::TILE_W);
+		const int r = int((t.y - Element::MAP_TEX_PAD_Y) / TileGrid::TILE_H);
+		assert(tiles.isRoad(c, r));
+	}
+
+	// grass in the top-left corner, road on the first segment, off-map
+	assert(tiles.canPlace({0, 0}));
+	assert(!tiles.canPlace(TileGrid::footprintAt({TURNS[0].x, TURNS[0].y + 40})));
+	assert(!tiles.canPlace({-1, 0}) && !tiles.canPlace({TileGrid::COLS - 1, 0}));
+
+	// footprints snap to the tiles and block each other
+	const SDL_Point cell = TileGrid::footprintAt(TileGrid::footprintCenter({0, 0}));
+	assert(cell.x == 0 && cell.y == 0);
+	tiles.place({0, 0}, ent_type{7});
+	assert(!tiles.canPlace({0, 0}) && !tiles.canPlace({1, 1}) && tiles.canPlace({0, 2}));
+	assert(tiles.hasTower(1, 1) && tiles.towerAt(1, 1).id == 7 && !tiles.hasTower(2, 0));
+	cout << "test_TileGrid passed\n";
+}
+
+void test_Snapshot() {
+	using element::Transform;
+	using element::HP;
+
+	Entity a = Entity::create();
+	a.addAll(Transform{{1,2},30}, HP{10,10});
+	a.add(ArchPos{5,6});
+	Entity b = Entity::create();
+	b.add(Transform{{3,4},60});
+	b.add(OnlyTag{});
+
+	Snapshot s;
+	World::snapshot(s);
+	const int transforms = SoAPackedStorage<Transform>::size();
+
+	// diverge: edit, destroy, reuse the freed id
+	a.get<Transform>().p.x = 100;
+	a.get<HP>().current = 1;
+	b.destroy();
+	Entity c = Entity::create();
+	c.add(ArchPos{7,8});
+	assert(c.entity().id == b.entity().id);
+
+	assert(World::restore(s));
+	assert(a.alive() && b.alive() && !c.alive());
+	assert(a.get<Transform>().p.x == 1 && a.get<HP>().current == 10);
+	assert(b.get<Transform>().a == 60 && World::singleton<OnlyTag>().id == b.entity().id);
+	assert(World::getComponent<ArchPos>(a.entity()).y == 6 && !b.has<ArchPos>());
+	assert(SoAPackedStorage<Transform>::size() == transforms);
+
+	// the on-disk copy is mapped back in; foreign or truncated bytes are rejected
+	assert(World::snapshot("test_snapshot.bin"));
+	a.destroy();
+	assert(World::restore("test_snapshot.bin") && a.alive() && a.get<HP>().initial == 10);
+	remove("test_snapshot.bin");
+	assert(!World::restore(s.data(), s.size() - 1));
+	assert(!World::restore("missing.bin"));
+
+	// handles issued after the snapshot, at a reused and at a fresh id, stay dead
+	// after the rewind, also once their ids are handed out again
+	Snapshot early;
+	World::snapshot(early);
+	const id_type top = World::maxId().id;
+	b.destroy();
+	Entity reused = Entity::create();
+	assert(reused.entity().id == b.entity().id);
+	Entity fresh = Entity::create();
+	while (fresh.entity().id <= top)
+		fresh = Entity::create();
+	assert(World::restore(early) && b.alive() && !reused.alive() && !fresh.alive());
+	for (Entity e = Entity::create(); e.entity().id != fresh.entity().id; e = Entity::create())
+		assert(e.entity().id <= fresh.entity().id);
+	assert(!fresh.alive());
+	b.destroy();
+	assert(Entity::create().entity().id == reused.entity().id && !reused.alive());
+
+	assert(World::restore(early));
+	a.destroy();
+	b.destroy();
+	cout << "test_Snapshot passed\n";
+}
+
+template <int ...N>
+void addArchBits(Entity e, int bits, std::integer_sequence<int, N...>) {
+	((bits & 1 << N ? e.add(ArchBit<N>{bits}) : void()), ...);
+}
+
+template <int ...N>
+bool hasArchBits(Entity e, int bits, std::integer_sequence<int, N...>) {
+	return ((e.has<ArchBit<N>>() == bool(bits & 1 << N)
+		&& (!(bits & 1 << N) || e.get<ArchBit<N>>().n == bits)) && ...);
+}
+
+void test_SnapshotArchetypes() {
+	// one entity per set of archetype components, more sets than there are component bits
+	constexpr auto Bits = std::make_integer_sequence<int, 7>{};
+	const int sets = Params.MaxComponents + 8;
+	std::vector<Entity> ents;
+	for (int bits = 1; bits <= sets; ++bits) {
+		ents.push_back(Entity::create());
+		addArchBits(ents.back(), bits, Bits);
+	}
+	assert(Archetypes::count() > Params.MaxComponents);
+
+	Snapshot s;
+	World::snapshot(s);
+	for (Entity e : ents)
+		e.destroy();
+	assert(World::restore(s));
+	for (int bits = 1; bits <= sets; ++bits)
+		assert(ents[bits-1].alive() && hasArchBits(ents[bits-1], bits, Bits));
+
+	for (Entity e : ents)
+		e.destroy();
+	cout << "test_SnapshotArchetypes passed\n";
+}
+
+void test_Scheduler() {
+	using element::Transform;
+	using element::HP;
+	using element::Velocity;
+
+	const Access move = Access::of(Reads<Velocity>{}, Writes<Transform>{});
+	const Access heal = Access::of(Reads<>{}, Writes<HP>{});
+	const Access draw = Access::of(Reads<Transform>{}, Writes<>{});
+	assert(!move.conflicts(heal) && move.conflicts(draw) && !draw.conflicts(heal));
+	assert(Access::of(Reads<>{}, Writes<>{}, Access::Structural).conflicts(heal));
+
+	// resources conflict among themselves only, and take no component bits
+	const index_type comps = compCounter;
+	const Access fill = Access::of(Reads<Transform>{}, Writes<Resource<element::SpatialGrid>>{});
+	const Access query = Access::of(Reads<Resource<element::SpatialGrid>>{}, Writes<HP>{});
+	assert(fill.conflicts(query) && !fill.conflicts(heal) && !query.conflicts(draw) && !query.conflicts(move));
+	assert(!Access::of(Reads<Resource<element::SpatialGrid>>{}, Writes<>{}).conflicts(query));
+	assert(compCounter == comps);
+
+	// a conflicting later task waits for the earlier one; independent ones overlap
+	for (int workers : {0, 3}) {
+		Scheduler s;
+		int trace[4] = {};
+		std::atomic<int> clock{0};
+		s.add(move, [&] { trace[0] = ++clock; });
+		s.add(heal, [&] { trace[1] = ++clock; });
+		s.add(draw, [&] { trace[2] = ++clock; });
+		s.add(Access::of(Reads<>{}, Writes<>{}, Access::Structural), [&] { trace[3] = ++clock; });
+		s.start(workers);
+		for (int run = 0; run < 100; ++run) {
+			clock = 0;
+			s.run();
+			assert(trace[0] < trace[2] && trace[3] == 4);
+			if (workers == 0)
+				assert(trace[0] == 1 && trace[1] == 2 && trace[2] == 3);
+		}
+	}
+	cout << "test_Scheduler passed\n";
+}
+
+void test_ParallelFor() {
+	using element::HP;
+
+	constexpr int N = 5000;
+	ent_type ents[N];
+	for (int i = 0; i < N; ++i) {
+		ents[i] = World::createEntity();
+		World::addComponent(ents[i], HP{i, 0});
+	}
+
+	// every entity is visited exactly once, inline and with workers stealing chunks
+	for (int workers : {0, 3}) {
+		Jobs::start(workers);
+		for (int run = 0; run < 20; ++run) {
+			parallel_for(World::view<HP>(), 64, [](ent_type, HP& hp) { ++hp.initial; });
+			std::atomic<int> sum{0};
+			Jobs::run(N, 7, [&](index_type first, index_type last) { sum += last - first; });
+			assert(sum == N);
+		}
+	}
+	Jobs::start(0);
+	for (int i = 0; i < N; ++i)
+		assert(World::getComponent<HP>(ents[i]).initial == 40);
+
+	World::destroyEntities(ents, N);
+	cout << "test_ParallelFor passed\n";
+}
+
+void test_CreateEntities() {
+	using element::Transform;
+	using element::HP;
+	using element::Creep_Tag;
+
+	// recycled ids first (the last destroyed is reused first), then fresh ones
+	const ent_type old = World::createEntity();
+	World::destroyEntity(old);
+	const id_type maxId = World::maxId().id;
+
+	constexpr int N = 300;
+	ent_type ents[N];
+	World::createEntities<Transform, HP, Creep_Tag>(N, [](index_type i, Transform& t, HP& hp, Creep_Tag&) {
+		t.p = {static_cast<float>(i), 0.f};
+		hp = {i, i};
+	}, ents);
+	assert(ents[0].id == old.id && ents[0].gen == old.gen + 1);
+	assert(World::maxId().id <= maxId + N);
+
+	int seen = 0;
+	for (int i = 0; i < N; ++i) {
+		assert(World::mask(ents[i]).test(MaskBuilder().set<Transform>().set<HP>().set<Creep_Tag>().build()));
+		assert(World::getComponent<Transform>(ents[i]).p.x == static_cast<float>(i));
+		assert(World::getComponent<HP>(ents[i]).current == i);
+	}
+	for (auto [e, hp]: World::view<HP>().with<Transform, Creep_Tag>()) {
+		(void)e; (void)hp;
+		++seen;
+	}
+	assert(seen == N);
+	// each storage took the batch as one dense run, in order
+	for (int i = 1; i < N; ++i)
+		assert(SoAPackedStorage<Transform>::index(ents[i]) == SoAPackedStorage<Transform>::index(ents[0]) + i);
+	assert(World::singleton<Creep_Tag>().id == ents[N-1].id);
+	World::destroyEntities(ents, N);
+
+	// sparse and archetype storages, without an id array
+	World::createEntities<element::Tint, ArchPos>(N, [](index_type i, element::Tint& t, ArchPos& p) {
+		t.color.r = static_cast<float>(i);
+		p = {static_cast<float>(i), 1.f};
+	});
+	std::vector<ent_type> made;
+	for (auto [e, p]: World::view<ArchPos>()) {
+		assert(World::getComponent<element::Tint>(e).color.r == p.x && p.y == 1.f);
+		made.push_back(e);
+	}
+	assert(made.size() == N);
+	World::destroyEntities(made.data(), N);
+	cout << "test_CreateEntities passed\n";
+}
+
+void test_ReserveShrink() {
+	using element::HP;
+
+	const auto hp = [] {
+		for (const ComponentInfo& c : Components)
+			if (strcmp(c.name, "element::HP") == 0)
+				return c.usage();
+		return Usage{};
+	};
+
+	// reserved up front, a batch of that size does not grow the storage
+	constexpr int N = 1000;
+	World::reserveEntities(N);
+	World::reserve<HP>(N);
+	const size_type reserved = hp().capacity;
+	assert(reserved >= hp().size + N);
+
+	ent_type ents[N];
+	for (int i = 0; i < N; ++i) {
+		ents[i] = World::createEntity();
+		World::addComponent(ents[i], HP{i, i});
+	}
+	assert(hp().capacity == reserved && hp().peak >= N);
+
+	// once they are gone, shrink hands the room back but keeps the high-water mark
+	World::destroyEntities(ents, N);
+	World::shrink();
+	assert(hp().capacity < reserved && hp().peak >= N);
+	assert(hp().bytes > 0);
+
+	cout << "test_ReserveShrink passed\n";
+}
+
+void test_BagMemory() {
+	constexpr bool arena = Params.Allocation == Memory::Arena;
+
+	// in the arena a bag keeps its address through growth and shrinking
+	const int* first;
+	{
+		DynamicBag<int, 2> bag;
+		first = bag.data();
+		for (int i = 0; i < 1 << 20; ++i)
+			bag.push(i);
+		assert(!arena || bag.data() == first);
+		for (int i = 0; i < 1 << 20; i += 4099)
+			assert(bag[i] == i);
+		while (bag.size() > 3)
+			bag.pop();
+		bag.shrink();
+		assert(bag.capacity() == 3 && bag[2] == 2);
+		assert(!arena || bag.data() == first);
+	}
+	// and a released slot goes to the next bag
+	DynamicBag<int, 2> next;
+	assert(!arena || next.data() == first);
+
+	// snapshot buffers always come from the heap
+#ifdef BAGEL_MMAP
+	Snapshot s;
+	World::snapshot(s);
+	assert(!ArenaMemory::owns(s.data()));
+#endif
+
+	cout << "test_BagMemory passed\n";
+}
+
+void test_Registry() {
+	using element::Transform;
+	using element::HP;
+	using element::Creep_Tag;
+
+	const auto find = [](const char* name) -> const ComponentInfo& {
+		for (const ComponentInfo& c : Components)
+			if (strcmp(c.name, name) == 0)
+				return c;
+		assert(false);
+		return Components[0];
+	};
+
+	// one row per BAGEL_STORAGE line, indices as the typed side sees them
+	static_assert(Components.size() == Registered::size);
+	const ComponentInfo& hp = find("element::HP");
+	const ComponentInfo& transform = find("element::Transform");
+	const ComponentInfo& creep = find("element::Creep_Tag");
+	assert(*hp.index == Component<HP>::Index && hp.bytes == sizeof(HP));
+	assert(transform.spans == 2 && hp.spans == 1 && creep.spans == 0);
+
+	const ent_type e = World::createEntity();
+	World::addComponents(e, Transform{{1.f, 2.f}, 3.f}, HP{7, 7}, Creep_Tag{});
+	assert(hp.has(e) && transform.has(e) && creep.has(e));
+
+	// raw spans reach the same data as the typed storages
+	const RawSpan hps = hp.span(0);
+	const index_type row = PackedStorage<HP>::index(e);
+	assert(row < hps.count && static_cast<HP*>(hps.data)[row].current == 7);
+	const RawSpan angles = transform.span(1);
+	assert(angles.stride == sizeof(float));
+	assert(static_cast<float*>(angles.data)[SoAPackedStorage<Transform>::index(e)] == 3.f);
+
+	// generic removal, and a second one is a no-op
+	for (const ComponentInfo& c : Components)
+		c.remove(e);
+	hp.remove(e);
+	assert(!hp.has(e) && !transform.has(e) && !creep.has(e));
+
+	World::destroyEntity(e);
+	cout << "test_Registry passed\n";
+}
+
 void run_tests() {
 	test1();
 	test_DynamicBag();
 	test_PackedStorage();
+	test_View();
+	test_DestroyReleasesComponents();
+	test_Generations();
+	test_CommandBuffer();
+	test_ArchetypeStorage();
+	test_SoAPackedStorage();
+	test_SpatialGrid();
+	test_PathTable();
+	test_Singleton();
+	test_Tables();
+	test_TileGrid();
+	test_Snapshot();
+	test_SnapshotArchetypes();
+	test_Scheduler();
+	test_ParallelFor();
+	test_CreateEntities();
+	test_ReserveShrink();
+	test_BagMemory();
+	test_Registry();
 }
\ No newline at end of file